@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * End-to-end latency benchmark for small loader invocations.
+ *
+ * Usage:
+ *     startupLatency [-n runs] <loader> <loader arguments>...
+ *
+ * Runs the loader 'runs' times (default 1000) with its output sent to
+ * /dev/null, timing each run from posix_spawn() to the end of waitpid(),
+ * and prints the minimum, median, 90th percentile and mean in microseconds.
+ * A few warm-up runs are done first so the page cache holds the binary and
+ * the object file. A run that exits non-zero stops the benchmark.
+ */
+
+extern char **environ;
+
+static int compareLatency(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double nowUs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e6 + (double)ts.tv_nsec / 1e3;
+}
+
+// Run the loader once; returns its latency in microseconds, or -1 on failure
+static double runOnce(char **argv, const posix_spawn_file_actions_t *actions) {
+    pid_t pid;
+    int status;
+    double start = nowUs();
+
+    if (posix_spawn(&pid, argv[0], actions, NULL, argv, environ) != 0) {
+        return -1;
+    }
+    if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        return -1;
+    }
+    return nowUs() - start;
+}
+
+int main(int argc, char *argv[]) {
+    int runs = 1000;
+    int first = 1;
+
+    if (argc > 2 && strcmp(argv[1], "-n") == 0) {
+        runs = atoi(argv[2]);
+        first = 3;
+    }
+    if (runs <= 0 || argc - first < 1) {
+        printf("Usage: %s [-n runs] <loader> <loader arguments>...\n", argv[0]);
+        return 1;
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+
+    double *latency = (double *)malloc((size_t)runs * sizeof(*latency));
+    if (!latency) {
+        return 1;
+    }
+
+    for (int i = 0; i < 10; i++) {
+        if (runOnce(argv + first, &actions) < 0) {
+            printf("Error: %s failed\n", argv[first]);
+            return 1;
+        }
+    }
+
+    double sum = 0;
+    for (int i = 0; i < runs; i++) {
+        latency[i] = runOnce(argv + first, &actions);
+        if (latency[i] < 0) {
+            printf("Error: %s failed\n", argv[first]);
+            return 1;
+        }
+        sum += latency[i];
+    }
+    qsort(latency, (size_t)runs, sizeof(*latency), compareLatency);
+
+    printf("%d runs: min %.1f us, median %.1f us, p90 %.1f us, mean %.1f us\n", runs,
+           latency[0], latency[runs / 2], latency[(size_t)runs * 9 / 10], sum / runs);
+
+    posix_spawn_file_actions_destroy(&actions);
+    free(latency);
+    return 0;
+}
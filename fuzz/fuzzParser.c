@@ -0,0 +1,18 @@
+#include "verify.h"
+
+#include <stdlib.h>
+
+/**
+ * libFuzzer entry point for the object file parser.
+ *
+ * Parses every input with objParseBuffer() and with the reference parser
+ * (refLoader.c) and aborts when they disagree on accepting the input or
+ * on any parsed record. Build with `make fuzzParser` (clang).
+ */
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    if (verifyParse((const char *)data, size, stderr) != 0) {
+        abort();
+    }
+    return 0;
+}
@@ -0,0 +1,28 @@
+#include "verify.h"
+
+#include <stdlib.h>
+
+/**
+ * libFuzzer entry point for the relocators.
+ *
+ * The first four bytes of the input pick the relocation address (24 bits)
+ * and the machine (low bit of the fourth byte); the rest is the object
+ * file. The input is loaded with the optimized modules and with the
+ * reference loader (refLoader.c), and any difference in the printed
+ * records or in how the input is rejected aborts the run. Build with
+ * `make fuzzRelocator` (clang).
+ */
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    if (size < 4) {
+        return 0;
+    }
+
+    uint32_t reloc = ((uint32_t)data[0] << 16) | ((uint32_t)data[1] << 8) | data[2];
+    machineType machine = (data[3] & 1) ? MACHINE_SICXE : MACHINE_SIC;
+
+    if (verifyBuffer((const char *)data + 4, size - 4, reloc, machine, stderr) != 0) {
+        abort();
+    }
+    return 0;
+}
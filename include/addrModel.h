@@ -0,0 +1,69 @@
+#ifndef ADDRMODEL_H
+#define ADDRMODEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "objFile.h"
+
+/**
+ * Address models of the target machines, and the relocation checks
+ * against them.
+ *
+ * This header declares:
+ *   - The addressModel struct and the two models: SIC addresses are 15
+ *     bits (32 KB), SIC/XE addresses are 20 bits (1 MB). Both machines
+ *     have 24-bit words, so an M field is at most a word wider than an
+ *     address.
+ *   - addrModelCheckProgram(), the up-front check: the relocated program
+ *     (every T record and the entry point) must lie inside the model's
+ *     address space
+ *   - The fixupLog struct, which the relocators fill while applying the
+ *     M records: the field value before each fixup, the value after it
+ *     before masking to the field width, and the address bits of the field
+ *   - addrModelCheckFixups(), the post-pass over a fixupLog
+ *
+ * A fixup stays inside the model when it does not carry into or borrow
+ * from the field bits above min(field bits, address bits): for an address
+ * field the result is an address of the model, and flag bits above the
+ * address (the SIC x bit) are left alone. The post-pass ORs
+ * (after ^ before) >> limit over the whole log, a loop without branches
+ * the compiler can vectorize. Only when that is non-zero does it look at
+ * each field exactly: a field with several M records (A - B pairs) is
+ * judged by its net change, so +R and -R on one field cancel out.
+ *
+ * Both checks call fatal() naming the relocator ("who") and, for fixups,
+ * the line of the first M record of the first field that leaves the model.
+ * The messages live in thread-local buffers, so relocators failing on
+ * several threads at once keep their own fatalMessage(). Errors while a
+ * log is live go through fixupLogFail(), which frees the log first.
+ */
+
+typedef struct {
+    const char *name; // Machine name used in messages
+    uint8_t addrBits; // Width of an address
+} addressModel;
+
+extern const addressModel addrModelSic;
+extern const addressModel addrModelSicXE;
+
+#define ADDR_WORD_BITS 24 // SIC and SIC/XE word size
+#define ADDR_INLINE_FIXUPS 64 // Fixups a log holds without allocating
+
+typedef struct {
+    uint32_t *before; // Field value before each fixup
+    uint32_t *after; // Field value after each fixup, not masked to the field
+    uint32_t *limit; // min(field bits, address bits) of each fixup
+    size_t count;
+    uint32_t *heap; // Storage for logs longer than ADDR_INLINE_FIXUPS
+    uint32_t inlineSlots[3 * ADDR_INLINE_FIXUPS];
+} fixupLog;
+
+void addrModelCheckProgram(const addressModel *model, const objFile *obj, int32_t R,
+                           const char *who);
+int fixupLogInit(fixupLog *log, size_t count);
+void fixupLogFree(fixupLog *log);
+void fixupLogFail(fixupLog *log, const char *msg);
+void addrModelCheckFixups(const addressModel *model, fixupLog *log, const objFile *obj,
+                          int32_t R, const char *who);
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "loader.h"
+
+/**
+ * Indexed object archives (--ar-create, --ar-append, --ar-list, --archive).
+ *
+ * This header declares:
+ *   - The on-disk layout constants of an archive
+ *   - archiveWrite(), which creates an archive from object files or appends
+ *     object files to an existing one
+ *   - archiveList(), which prints the index of an archive
+ *   - runArchiveLoad(), which relocates one named member, or every member,
+ *     straight out of the mapped archive
+ *
+ * Layout (all integers little-endian):
+ *
+ *     header  "SCOFFAR1", uint32 memberCount, uint32 0, uint64 indexOffset
+ *     data    the text of each member object file, back to back
+ *     index   memberCount entries sorted by name:
+ *             char name[8] (H record program name, NUL padded),
+ *             uint64 offset, uint64 length
+ *
+ * The implementation in archive.c:
+ *   - Parses every object file before adding it, and keys it by its H
+ *     record program name; names must be unique within an archive
+ *   - Appends by copying the old members, the new members and one merged
+ *     index into a temp file that is then renamed over the archive, so the
+ *     archive never holds a stale index and stays readable if an append is
+ *     interrupted
+ *   - Maps the archive and finds a member by binary search over the index;
+ *     the member's T records point straight into the mapping
+ */
+
+#define ARCHIVE_MAGIC "SCOFFAR1"
+#define ARCHIVE_HEADER_SIZE 24 // magic, member count, reserved, index offset
+#define ARCHIVE_ENTRY_SIZE 24 // name, offset, length
+#define ARCHIVE_NAME_SIZE 8 // Program names are at most 6 characters
+#define ARCHIVE_TEMP_SUFFIX ".tmp" // Appends are written here, then renamed
+
+int archiveWrite(const char *archivePath, const char *const *paths, size_t count, int append);
+int archiveList(const char *archivePath);
+int runArchiveLoad(const char *archivePath, const char *member, uint32_t reloc,
+                   machineType machine, outputMode mode);
+
+#endif
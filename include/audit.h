@@ -0,0 +1,38 @@
+#ifndef AUDIT_H
+#define AUDIT_H
+
+#include <stdio.h>
+#include "objFile.h"
+#include "sicxe.h"
+
+/**
+ * Fixup coverage audit for SIC/XE object programs (--audit).
+ *
+ * This header declares:
+ *   - sicxeFormat(), which returns the instruction format of an opcode
+ *     byte from a 256-entry table (FORMAT_NONE for bytes that are not
+ *     opcodes)
+ *   - auditSicXE(), which decodes the code of an unrelocated objFile and
+ *     cross-checks it against its M records
+ *
+ * The implementation in audit.c:
+ *   - Walks each run of contiguous T record bytes once, in address order,
+ *     with the opcode table; 3-byte words named by a 6-nibble M record are
+ *     skipped as data, and the walk re-synchronizes at every instruction
+ *     that a 5-nibble M record points into
+ *   - Reports format 4 instructions with a direct or indirect target inside
+ *     the program but no 5-nibble M record on their address field (missing
+ *     fixup), and 5-nibble M records that do not sit on the address field
+ *     of a format 4 instruction (spurious fixup)
+ *   - Writes one "Warning: line N: ..." line per finding to the report
+ *     stream and returns the number of findings
+ *
+ * Object code and data share the T records, so a data area that happens to
+ * decode as a format 4 instruction can give a false "missing" warning.
+ * Immediate operands (#value) are never expected to have a fixup.
+ */
+
+SicXeFormat sicxeFormat(uint8_t opcode);
+int auditSicXE(const objFile *obj, FILE *report);
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <stddef.h>
+
+/**
+ * Validate-only preflight mode of the loader (--check).
+ *
+ * This header declares:
+ *   - runCheck(), which validates a list of object files with
+ *     objCheckFile() and reports pass/fail for each one
+ *
+ * The implementation in check.c:
+ *   - Checks the files on several threads (see parallel.h)
+ *   - Prints "PASS <file>" or "FAIL <file>" in the order the files were
+ *     given, followed by a summary line
+ *   - Returns 0 when every file passed and 1 otherwise
+ */
+
+int runCheck(const char *const *paths, size_t count, unsigned int jobs);
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+/**
+ * Transparent gzip / zstd compression of object files and outputs.
+ *
+ * This header declares:
+ *   - The compressFormat enum
+ *   - compressDetect(), which recognizes compressed data by its magic bytes
+ *   - compressForPath(), which picks the format of an output by its file
+ *     name extension (".gz", ".zst")
+ *   - The compressStream struct: a FILE connected through a pipe to a
+ *     gzip or zstd process working on a file
+ *   - compressOpenRead(), compressOpenWrite() and compressClose()
+ *   - compressReadFile(), which reads the whole decompressed contents of a
+ *     file into one malloc()ed buffer
+ *
+ * The implementation in compress.c runs the system's gzip / zstd tools with
+ * posix_spawnp(), so the loader needs no compression library, but those
+ * programs must be on PATH at run time. The tool runs as its own process,
+ * so decompression overlaps with whatever the loader does with the text it
+ * reads: objParseFile() and objCheckFile() parse it block by block, and
+ * --stream mode parses it program by program. compressReadFile() is for
+ * callers that need the whole text first (objScanMetadata()).
+ * compressClose() waits for the tool and fails if it did not exit cleanly,
+ * so a truncated or corrupt input is an error rather than a short file.
+ */
+
+typedef enum {
+    COMPRESS_NONE = 0,
+    COMPRESS_GZIP = 1,
+    COMPRESS_ZSTD = 2
+} compressFormat;
+
+typedef struct {
+    FILE *fp; // Decompressed text (read) or text to compress (write)
+    long pid; // The gzip / zstd process
+} compressStream;
+
+#define COMPRESS_MAGIC_BYTES 4 // Bytes compressDetect() needs to see
+
+compressFormat compressDetect(const void *head, size_t length);
+compressFormat compressForPath(const char *path);
+int compressOpenRead(const char *path, compressFormat format, compressStream *stream);
+int compressOpenWrite(const char *path, compressFormat format, compressStream *stream);
+int compressClose(compressStream *stream);
+int compressReadFile(const char *path, compressFormat format, char **data, size_t *length);
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef EMIT_H
+#define EMIT_H
+
+#include <stddef.h>
+#include "objFile.h"
+
+/**
+ * Fan-out emitter for relocated programs (--emit).
+ *
+ * This header declares:
+ *   - The emitFormat enum: SCOFF T/E text, flat binary, Intel HEX and
+ *     Motorola S-record
+ *   - The emitTarget struct, one output format and destination
+ *   - emitParseTarget(), which reads a "<format>:<path>" option value
+ *   - emitRecords(), which writes a relocated objFile to every target
+ *
+ * The implementation in emit.c:
+ *   - Walks the relocated T records once and hands each record's bytes to
+ *     every sink, so the records are never re-read or re-parsed
+ *   - Gives each sink its own output buffer, flushed with fwrite() when it
+ *     fills up and when the sink is closed
+ *   - Writes the SCOFF sink exactly as printRelocatedRecords() does
+ *   - Writes the flat binary starting at the lowest loaded address, with
+ *     gaps between T records filled with zero bytes
+ *
+ * A path of "-" writes to stdout. A path ending in ".gz" or ".zst" is
+ * written compressed.
+ */
+
+typedef enum {
+    EMIT_SCOFF = 0, // T and E records
+    EMIT_BIN = 1, // Flat memory image
+    EMIT_IHEX = 2, // Intel HEX (I32HEX: type 00, 01, 04, 05 records)
+    EMIT_SREC = 3 // Motorola S-record (S0, S2, S8)
+} emitFormat;
+
+typedef struct {
+    emitFormat format;
+    const char *path; // Destination file, "-" for stdout
+} emitTarget;
+
+#define EMIT_BUFFER_SIZE (64U * 1024U) // Output buffer of each sink
+#define EMIT_LINE_BYTES 16 // Data bytes per Intel HEX / S-record line
+
+int emitParseTarget(const char *spec, emitTarget *out);
+void emitRecords(const objFile *obj, const emitTarget *targets, size_t count);
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef IMAGEINDEX_H
+#define IMAGEINDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "objFile.h"
+
+/**
+ * Address-indexed queries over a relocated objFile (--query).
+ *
+ * This header declares:
+ *   - The imageFixup struct: one M record with its field moved to the
+ *     relocated address
+ *   - The imageIndex struct: the T records and the fixups of one program,
+ *     each sorted by relocated address
+ *   - imageIndexBuild() / imageIndexFree()
+ *   - Lookups, each a binary search over the sorted starts:
+ *       * imageFindRecord(): the T record holding an address
+ *       * imageReadByte(), imageReadWord() and imageReadRange(): the
+ *         relocated bytes at an address
+ *       * imageFixupsAt(): the window of fixups that start close enough
+ *         to cover an address; fixup f covers it when
+ *         address - f->address < f->byteCount
+ *   - printImageQuery(), the --query report for one address
+ *
+ * The index reads the relocated T records in place and never touches the
+ * simulated memory. Records relocation did not decode are read from their
+ * hex text. T records do not overlap (objValidateLayout()), so at most one
+ * record holds an address.
+ *
+ * The objFile must outlive the index and must not change while it is used.
+ */
+
+typedef struct {
+    uint32_t address; // Relocated address of the first byte of the field
+    uint8_t byteCount; // Bytes the field spans
+    const modRecord *mod; // The M record (its address is the unrelocated one)
+} imageFixup;
+
+typedef struct {
+    const objFile *obj;
+    const textRecord **text; // Non-empty T records by address
+    size_t textCount;
+    imageFixup *fixups; // Fixups by relocated address
+    size_t fixupCount;
+    uint8_t maxFieldBytes; // Widest fixup field, bounds the fixup search
+} imageIndex;
+
+#define IMAGE_WORD_BYTES 3 // SIC and SIC/XE words are 24 bits
+
+int imageIndexBuild(imageIndex *index, const objFile *obj);
+void imageIndexFree(imageIndex *index);
+const textRecord *imageFindRecord(const imageIndex *index, uint32_t address);
+int imageReadByte(const imageIndex *index, uint32_t address, uint8_t *out);
+int imageReadWord(const imageIndex *index, uint32_t address, uint32_t *out);
+size_t imageReadRange(const imageIndex *index, uint32_t address, uint8_t *out, size_t length);
+size_t imageFixupsAt(const imageIndex *index, uint32_t address, const imageFixup **first);
+void printImageQuery(const imageIndex *index, uint32_t address, FILE *out);
+
+#endif
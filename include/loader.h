@@ -2,6 +2,8 @@
 #define LOADER_H
 
 #include <stdint.h>
+#include <stdio.h>
+#include "emit.h"
 #include "objFile.h"
 
 /*
@@ -9,14 +11,20 @@
  *
  * This header defines:
  *   - The MachineType enum (SIC vs SICXE)
+ *   - The outputMode enum (full relocated image vs. changed fields only)
  *   - The LoaderConfig struct, which contains the command-line configurations
  *   - The runLoader() API, which drives the whole loading/relocation pipeline
+ *   - The individual pipeline stages (relocateObject(), printRelocatedRecords(),
+ *     printDeltaRecords()) for modes that drive several objects at once
  *
  * The implementation in loader.c:
  *   - Parses a objFile using objParser.c
  *   - Invokes the appropriate relocation backend funcitons relocSic.c or 
  *     relocSicxe.c depending on the case
- *   - Emits relocated T and E records to stdout
+ *   - Emits relocated T and E records to stdout, either every record
+ *     (OUTPUT_FULL) or only the bytes relocation changed (OUTPUT_DELTA),
+ *     or hands the relocated program to emitRecords() when --emit
+ *     targets are given, or answers --query addresses from an imageIndex
  */
 
 
@@ -26,14 +34,32 @@ typedef enum {
     MACHINE_SICXE = 1
 } machineType;
 
+// Output mode enum
+typedef enum {
+    OUTPUT_FULL = 0, // Every relocated T record plus the E record
+    OUTPUT_DELTA = 1 // Only the bytes relocation changed, as minimal T records
+} outputMode;
+
 // Loader configuration passed from main.c
 typedef struct {
     const char *filePath;
     uint32_t relocationAddress;
     machineType machineType;
+    outputMode outputMode;
+    unsigned int jobs; // Parser threads for large object files
+    int audit; // 1 = check SIC/XE fixup coverage before relocating (audit.h)
+    const emitTarget *emitTargets; // --emit outputs replacing stdout (emit.h)
+    size_t emitCount; // Number of emitTargets, 0 = print to stdout
+    const uint32_t *queries; // --query addresses answered instead of printing (imageIndex.h)
+    size_t queryCount;
 } LoaderConfig;
 
 // Main loader entry point
 int runLoader(const LoaderConfig *config);
 
+// Pipeline stages shared by the other loader modes
+void relocateObject(objFile *obj, uint32_t reloc, machineType machine);
+void printRelocatedRecords(const objFile *obj, FILE *out);
+void printDeltaRecords(const objFile *obj, FILE *out);
+
 #endif
@@ -12,9 +12,12 @@
  *   - A fixed-size byte array representing main memory
  *   - Functions to initialize memory
  *   - Byte and word read/write operations
+ *   - Block operations (write, read, fill, compare) over a byte span
+ *   - Big-endian field accessors 1 to 4 bytes wide
  *
  * The implementation in memory.c:
- *   - Enforces bounds checking for memory accesses
+ *   - Enforces bounds checking for memory accesses; block and field
+ *     operations check the whole span once, then copy with memcpy/memset
  *   - Implements SIC-style 3-byte word reads/writes
  */
 
@@ -24,5 +27,11 @@ uint8_t memReadByte(uint32_t addr);
 void memWriteWord(uint32_t addr, uint32_t value); // 3-byte SIC word
 uint32_t memReadWord(uint32_t addr);
 
-#endif
+void memWriteBlock(uint32_t addr, const uint8_t *src, uint32_t len);
+void memReadBlock(uint32_t addr, uint8_t *dst, uint32_t len);
+void memFill(uint32_t addr, uint8_t value, uint32_t len);
+int memCompare(uint32_t addr, const uint8_t *src, uint32_t len);
+void memWriteField(uint32_t addr, uint32_t value, uint8_t width); // 1-4 bytes, big-endian
+uint32_t memReadField(uint32_t addr, uint8_t width);
 
+#endif
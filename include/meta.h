@@ -0,0 +1,31 @@
+#ifndef META_H
+#define META_H
+
+#include <stddef.h>
+
+/**
+ * Metadata scan mode of the loader (--meta).
+ *
+ * This header declares:
+ *   - The metaFormat enum (CSV or JSON table)
+ *   - runMeta(), which prints the program name, start address, length
+ *     and entry point of every object file under the given paths
+ *
+ * The implementation in meta.c:
+ *   - Expands directories recursively (entries in name order, hidden
+ *     entries skipped) into one list of files
+ *   - Reads each file with objScanMetadata(), which only looks at the H
+ *     record at the start and the E record at the end, on several threads
+ *     (see parallel.h)
+ *   - Prints one row per file in list order, and returns 1 if any file
+ *     could not be scanned, 0 otherwise
+ */
+
+typedef enum {
+    META_CSV = 0,
+    META_JSON = 1
+} metaFormat;
+
+int runMeta(const char *const *paths, size_t count, metaFormat format, unsigned int jobs);
+
+#endif
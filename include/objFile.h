@@ -8,13 +8,32 @@
  * This header declares:
  *   - Structs representing H (header), T (text), M (modification), and E (end) records
  *   - The objFile aggregate structure that holds all records
- *   - The parsing functions: objParseFile() and objFree()
+ *   - The parsing functions: objParseFile(), objParseBuffer() and objFree()
+ *   - Multi-threaded variants for large inputs: objParseFileParallel() and
+ *     objParseBufferParallel()
+ *   - objCheckFile(), which runs the same structural and layout checks
+ *     without building record arrays or decoding payload bytes
+ *   - objScanMetadata(), which reads just the H and E records: the H
+ *     record from the start of the file and the E record from its end,
+ *     without reading the T and M records in between
+ *   - Lazy T-record helpers: objDecodeHex(), objDecodeText() and
+ *     objMarkModifiedText()
  *
  * The implementation in objFileParser.c:
  *   - Reads a textual SIC/SICXE object file line by line
  *   - Parses each H/T/M/E record into the corresponding C structs
  *   - Performs basic validation on lengths, addresses, and record ordering
+ *   - Checks the layout of the whole file (objValidateLayout()): T records
+ *     may not overlap and every M field must lie inside loaded text. The
+ *     parse functions print nothing; when the layout check makes a parse
+ *     fail, objParseMessage() describes the first conflict (per thread,
+ *     like fatalMessage())
  *   - Releases any dynamic memory allocated inside a objFile
+ *
+ * T record payloads are not decoded while parsing. Each textRecord keeps a
+ * pointer to its hex digits in the source text, and only the records an
+ * M record touches are decoded (objDecodeText()) and re-encoded on output.
+ * Every other record is written back by copying its original hex text.
  */
 
 #include <stdint.h>
@@ -24,6 +43,12 @@
 #include <ctype.h>
 
 #define MAX_T_BYTES 32 // Max T-record length
+#define OBJ_PARALLEL_MIN_CHUNK (256U * 1024U) // Smallest input slice worth its own parser thread
+#define OBJ_INLINE_RECORDS 16 // T and M records a parse keeps on the stack before allocating
+#define OBJ_SMALL_FILE (64U * 1024U) // Files up to this size are read() instead of mmap()ed
+#define OBJ_STREAM_BLOCK (64U * 1024U) // Decompressed text parsed per step of a compressed file
+#define OBJ_META_HEAD_BYTES 4096 // Bytes read from the start of a file to find its H record
+#define OBJ_META_TAIL_BYTES 512 // First block read from the end of a file to find its E record
 
 // Represents the header record
 typedef struct {
@@ -36,7 +61,11 @@ typedef struct {
 typedef struct {
     uint32_t address; // Starting address where this text record should be loaded
     uint32_t length; // Number of bytes contained in this text record
-    uint8_t bytes[MAX_T_BYTES]; // Object code bytes
+    uint8_t bytes[MAX_T_BYTES]; // Object code bytes (valid only once decoded)
+    const char *hexText; // Original hex payload inside the objFile source text
+    uint8_t decoded; // 1 when bytes[] holds the record contents
+    uint8_t modified; // 1 when an M record field lands inside this record
+    uint32_t line; // Line number of the record in the object file
 } textRecord;
 
 // Represents the modification record
@@ -44,6 +73,7 @@ typedef struct {
     uint32_t address; // Address of the field to modify
     uint8_t lengthNibbles; // Number of nibbles to modify
     char sign; // Relocation operator: '+' to add, '-' to subtract
+    uint32_t line; // Line number of the record in the object file
 } modRecord;
 
 // Represents the end record
@@ -51,6 +81,12 @@ typedef struct {
     uint32_t firstExecAddress; // Starting load address of the program
 } endRecord;
 
+// Program metadata from the H and E records only (objScanMetadata())
+typedef struct {
+    headerRecord header; // Name, start address and length
+    endRecord endRecord; // Entry point
+} objMetadata;
+
 // struct representation of a SIC/SICXE object file.
 typedef struct {
     headerRecord header; // Parsed H record information
@@ -59,9 +95,23 @@ typedef struct {
     modRecord *modRecords; // Array of M records
     size_t modCount; // Number of modification records parsed
     endRecord endRecord; // E record information
+    char *source; // Object file text the T records point into (owned)
+    size_t sourceLength; // Size of source in bytes
+    int sourceMapped; // 1 if source is a mmap()ed view of the file
+    int32_t relocFactor; // Set by relocation: new minus old start address (M addresses stay unrelocated)
 } objFile;
 
 int objParseFile(const char *path, objFile *out);
+int objParseBuffer(const char *data, size_t length, objFile *out);
+int objParseFileParallel(const char *path, objFile *out, unsigned int jobs);
+int objParseBufferParallel(const char *data, size_t length, objFile *out, unsigned int jobs);
+int objCheckFile(const char *path);
+int objScanMetadata(const char *path, objMetadata *out);
+int objDecodeHex(const char *hex, size_t byteCount, uint8_t *out);
+int objDecodeText(textRecord *t);
+int objMarkModifiedText(objFile *obj);
+int objValidateLayout(const objFile *obj, FILE *report);
+const char *objParseMessage(void);
 void objFree(objFile *file);
 
 #endif
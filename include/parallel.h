@@ -0,0 +1,44 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+/**
+ * Small threading helpers for the batch modes of the loader.
+ *
+ * This header declares:
+ *   - parallelFor(), which runs a callback for every index 0..count-1
+ *     on a fixed number of worker threads
+ *   - defaultJobCount(), the number of online processors
+ *   - boundedQueue, a fixed-capacity FIFO of pointers connecting the
+ *     stages of a pipeline; producers block when it is full and
+ *     consumers block when it is empty
+ *
+ * Implemented in parallel.c with POSIX threads. Workers pull the next
+ * index from a shared atomic counter, so uneven items balance out.
+ */
+
+typedef void (*parallelTask)(size_t index, void *ctx);
+
+typedef struct {
+    void **items; // Ring of queued items
+    size_t capacity; // Maximum number of queued items
+    size_t head; // Index of the oldest item
+    size_t count; // Number of queued items
+    int closed; // Set by queueClose(): no more pushes
+    pthread_mutex_t lock;
+    pthread_cond_t notEmpty;
+    pthread_cond_t notFull;
+} boundedQueue;
+
+void parallelFor(size_t count, unsigned int jobs, parallelTask task, void *ctx);
+unsigned int defaultJobCount(void);
+
+int queueInit(boundedQueue *q, size_t capacity);
+void queueDestroy(boundedQueue *q);
+int queuePush(boundedQueue *q, void *item); // -1 once the queue is closed
+void *queuePop(boundedQueue *q); // NULL once the queue is closed and empty
+void queueClose(boundedQueue *q);
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "loader.h"
+
+/**
+ * Automatic placement of several programs in one address space (--place).
+ *
+ * This header declares:
+ *   - placePrograms(), a best-fit interval allocator that assigns each
+ *     program length a start address inside [base, limit), honouring an
+ *     alignment
+ *   - runPlacement(), which parses N object files, places them with
+ *     placePrograms(), relocates all of them into one shared memory image
+ *     and prints the combined T/E records plus a load map
+ *
+ * Implemented in placement.c.
+ */
+
+int placePrograms(const uint32_t *lengths, size_t count, uint32_t base,
+                  uint32_t limit, uint32_t align, uint32_t *starts);
+int runPlacement(const char *const *paths, size_t count, machineType machine,
+                 uint32_t align, const char *mapPath);
+
+#endif
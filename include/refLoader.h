@@ -0,0 +1,35 @@
+#ifndef REF_LOADER_H
+#define REF_LOADER_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "loader.h"
+#include "objFile.h"
+
+/**
+ * Reference implementation of the relocating loader.
+ *
+ * This header declares:
+ *   - refParseBuffer(), a line-by-line parser that decodes every T record
+ *     into bytes[] right away
+ *   - refRelocate(), which loads every byte into a private memory image,
+ *     applies each M record one byte at a time and reads the records back
+ *   - refPrintRecords(), which prints the relocated T and E records one
+ *     byte at a time
+ *
+ * The implementation in refLoader.c is the straightforward version of the
+ * loader: no mmap, no lazy decoding, no block copies, no threads. It accepts
+ * and rejects exactly the same inputs as objParseBuffer() and
+ * relocateObject() and prints the same text, so verify.c can compare the
+ * optimized paths against it byte for byte. Change it only together with
+ * a change of the accepted format or the relocation rules.
+ *
+ * refRelocate() reports errors through fatal() with the same messages as
+ * relocSic.c / relocSicXE.c and memory.c.
+ */
+
+int refParseBuffer(const char *data, size_t length, objFile *out);
+void refRelocate(objFile *obj, uint32_t reloc, machineType machine);
+void refPrintRecords(const objFile *obj, FILE *out);
+
+#endif
@@ -13,7 +13,7 @@
 
 
 #define SIC_WORD_SIZE 3       // bytes
-#define SIC_ADDR_BITS 24      // 24-bit addressing
+#define SIC_ADDR_BITS 15      // 15-bit addresses (the x bit sits above them)
 #define SIC_MAX_MEMORY 32768  // 32 KB
 
 #endif
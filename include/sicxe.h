@@ -6,6 +6,8 @@
  *
  * This header provides:
  *   - Basic enums and constants for SIC/XE instruction formats (1, 2, 3, 4)
+ *   - The n/i/e flag bits that tell format 3 and format 4 apart
+ *   - Address width and memory size of the SIC/XE machine
  *   - A place to add SIC/XE-specific flags or addressing-mode helpers
  *
  * Used primarily by relocSicXE.c to interpret and update relocated addresses
@@ -13,7 +15,17 @@
  */
 
 
+#define SICXE_ADDR_BITS 20        // 20-bit addresses (format 4)
+#define SICXE_MAX_MEMORY 1048576  // 1 MB
+
+#define SICXE_OPCODE_MASK 0xFC    // opcode bits of a format 3/4 first byte
+#define SICXE_NI_MASK 0x03        // n and i bits of a format 3/4 first byte
+#define SICXE_NI_IMMEDIATE 0x01   // n=0 i=1: #operand, not an address
+#define SICXE_E_BIT 0x10          // e bit of the second byte: format 4
+#define SICXE_FORMAT4_NIBBLES 5   // M record length of a format 4 address field
+
 typedef enum {
+    FORMAT_NONE = 0,            // not an opcode (data)
     FORMAT1 = 1,
     FORMAT2 = 2,
     FORMAT3 = 3,
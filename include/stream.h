@@ -0,0 +1,36 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stdint.h>
+#include "loader.h"
+
+/**
+ * Streaming mode of the loader (--stream).
+ *
+ * This header declares:
+ *   - The streamConfig struct: input, relocation addresses, machine and
+ *     output mode of a stream run
+ *   - runStream(), which relocates a stream of concatenated H..E programs
+ *
+ * The implementation in stream.c runs three pipelined stages connected by
+ * bounded queues (see parallel.h):
+ *   - reader: splits the input into programs (a new program starts at an
+ *     H record that follows an E record) and parses each one
+ *   - relocator: relocates each program into a freshly cleared memory
+ *   - emitter (calling thread): prints the relocated records in input order
+ * so one program is parsed while the previous one is relocated and printed.
+ */
+
+typedef struct {
+    const char *inputPath; // Object stream, "-" for stdin
+    uint32_t baseAddress; // Relocation address of the first program
+    uint32_t stride; // Added to the address for each following program; 0 packs
+                     // each program right after the previous one's length
+    const char *relocsPath; // Optional file with one hex address per program
+    machineType machineType;
+    outputMode outputMode;
+} streamConfig;
+
+int runStream(const streamConfig *config);
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+/**
+ * Opt-in phase tracing for the relocating loader.
+ *
+ * This header declares:
+ *   - traceOpen(), which turns tracing on and names the output file
+ *   - traceNow() / traceSpan(), used around each loader phase
+ *     (open, parse, plan, fixup, emit) to record one span
+ *
+ * The implementation in trace.c:
+ *   - Keeps a fixed-size ring buffer per thread, so recording a span
+ *     never takes a lock; when a ring is full the oldest spans are lost
+ *   - Writes every ring as Chrome trace-event JSON at exit, which
+ *     chrome://tracing and Perfetto (ui.perfetto.dev) can load
+ *
+ * When tracing is off traceNow() returns 0 and traceSpan() returns
+ * immediately.
+ */
+
+#define TRACE_RING_SIZE 4096 // Spans kept per thread
+
+int traceOpen(const char *path);
+int traceEnabled(void);
+uint64_t traceNow(void); // Microseconds on a monotonic clock
+void traceSpan(const char *name, const char *object, uint64_t startUs,
+               uint64_t bytes, uint64_t records);
+
+#endif
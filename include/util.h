@@ -1,6 +1,7 @@
 #ifndef UTIL_H
 #define UTIL_H
 
+#include <setjmp.h>
 #include <stdint.h>
 
 /**
@@ -9,13 +10,19 @@
  * This header declares helpers for:
  *   - Parsing unsigned 32-bit hexadecimal integers from strings
  *   - Reporting fatal errors and terminating the program
+ *   - Trapping fatal errors on the current thread (fatalSetTrap()), for
+ *     long-running modes that must survive one bad object file; the
+ *     trapped message is available from fatalMessage()
  *
  * Implemented in util.c and used by main.c, loader.c, parser,
  * and relocation modules.
  */
 
 int parseHex (const char *s, uint32_t *out);
-void fatal(const char *msg);
+_Noreturn void fatal(const char *msg);
+_Noreturn void fatalPath(const char *what, const char *path); // "what: path"
+jmp_buf *fatalSetTrap(jmp_buf *env);
+const char *fatalMessage(void);
 
 #endif
 
@@ -0,0 +1,39 @@
+#ifndef VERIFY_H
+#define VERIFY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "loader.h"
+
+/**
+ * Differential testing of the loader against its reference implementation
+ * (--verify and --fuzz).
+ *
+ * This header declares:
+ *   - verifyParse(), which parses one buffer with objParseBuffer() and
+ *     refParseBuffer() and compares the results record by record
+ *   - verifyBuffer(), which parses, relocates and prints one buffer with
+ *     both implementations and compares the printed text byte for byte
+ *   - runVerify(), which runs both checks on a list of object files at
+ *     several relocation addresses on both machines
+ *   - runFuzz(), which does the same on generated valid and near-valid
+ *     SCOFF programs
+ *
+ * The implementation in verify.c:
+ *   - Traps fatal() (fatalSetTrap()) around relocation, so a rejection by
+ *     the relocator is compared too: both sides must fail with the same
+ *     message, or both must succeed with the same output
+ *   - Writes a description of every mismatch to the report stream and
+ *     returns non-zero
+ *
+ * The libFuzzer entry points in fuzz/ call verifyParse() and verifyBuffer().
+ */
+
+int verifyParse(const char *data, size_t length, FILE *report);
+int verifyBuffer(const char *data, size_t length, uint32_t reloc,
+                 machineType machine, FILE *report);
+int runVerify(const char *const *paths, size_t count);
+int runFuzz(unsigned long count, unsigned long seed);
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+/**
+ * Watch mode of the loader (--watch).
+ *
+ * This header declares:
+ *   - runWatch(), which keeps the relocated outputs of every object file
+ *     in a directory up to date
+ *
+ * The relocation config is a text file with one entry per line:
+ *
+ *     <fileName|*> <relocAddressHex> <SIC|SICXE>
+ *
+ * '*' gives the address and machine of every file without its own entry.
+ * Blank lines and lines starting with '#' are ignored.
+ *
+ * The implementation in watch.c:
+ *   - Loads every configured object once at startup
+ *   - Waits for inotify events and re-parses and re-relocates only the
+ *     files that were written or moved into the directory
+ *   - Keeps each object's relocated output and the stat() signature of
+ *     the file it came from in memory; an event on a file whose
+ *     signature did not change is answered from the cache
+ *   - Replaces <outDir>/<fileName>.reloc atomically (temp file + rename)
+ *     only when the output really changed
+ *
+ * Watch mode needs inotify, so it is only available on Linux.
+ */
+
+int runWatch(const char *dirPath, const char *configPath, const char *outDir);
+
+#endif
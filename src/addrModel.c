@@ -0,0 +1,165 @@
+#include "addrModel.h"
+#include "sic.h"
+#include "sicxe.h"
+#include "util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Implementation of the address-model checks.
+ *
+ * This file implements:
+ *   - The SIC (15-bit) and SIC/XE (20-bit) models
+ *   - addrModelCheckProgram(): one min/max pass over the header range,
+ *     the T records and the entry point, then a single range test of the
+ *     relocated span
+ *   - fixupLogInit() / fixupLogFree(): the three log arrays share one
+ *     block, on the stack for small programs
+ *   - fixupLogFail(): frees the log, then calls fatal(), so a trapped
+ *     fatal() (--watch, --verify) does not leak a heap log
+ *   - addrModelCheckFixups(): the branch-free OR over the log, and the
+ *     exact per-field pass (fieldViolation()) that only runs when the OR
+ *     is non-zero
+ */
+
+const addressModel addrModelSic = {"SIC", SIC_ADDR_BITS};
+const addressModel addrModelSicXE = {"SIC/XE", SICXE_ADDR_BITS};
+
+void addrModelCheckProgram(const addressModel *model, const objFile *obj, int32_t R,
+                           const char *who) {
+    uint64_t lo = obj->header.startAddress;
+    uint64_t hi = (uint64_t)obj->header.startAddress + obj->header.programLength;
+    uint64_t entry = obj->endRecord.firstExecAddress;
+
+    for (size_t i = 0; i < obj->textCount; i++) {
+        const textRecord *t = &obj->textRecords[i];
+        uint64_t start = t->address;
+        uint64_t end = (uint64_t)t->address + t->length;
+        lo = (start < lo) ? start : lo;
+        hi = (end > hi) ? end : hi;
+    }
+    lo = (entry < lo) ? entry : lo;
+    hi = (entry + 1 > hi) ? entry + 1 : hi;
+
+    int64_t first = (int64_t)lo + R;
+    int64_t last = (int64_t)hi + R; // One past the last byte
+    if (first < 0 || last > ((int64_t)1 << model->addrBits)) {
+        static _Thread_local char msg[160]; // fatalMessage() keeps pointing here
+        snprintf(msg, sizeof(msg),
+                 "%s: relocation by %c%06X puts the program outside the %u-bit %s address space",
+                 who, (R < 0) ? '-' : '+', (unsigned int)((R < 0) ? -(int64_t)R : R),
+                 (unsigned int)model->addrBits, model->name);
+        fatal(msg);
+    }
+}
+
+int fixupLogInit(fixupLog *log, size_t count) {
+    uint32_t *slots = log->inlineSlots;
+
+    log->heap = NULL;
+    if (count > ADDR_INLINE_FIXUPS) {
+        log->heap = (uint32_t *)malloc(3 * count * sizeof(*log->heap));
+        if (!log->heap) {
+            return -1;
+        }
+        slots = log->heap;
+    }
+    log->before = slots;
+    log->after = slots + count;
+    log->limit = slots + 2 * count;
+    log->count = count;
+    return 0;
+}
+
+void fixupLogFree(fixupLog *log) {
+    free(log->heap);
+    log->heap = NULL;
+}
+
+void fixupLogFail(fixupLog *log, const char *msg) {
+    fixupLogFree(log);
+    fatal(msg);
+}
+
+// Sort key of one fixup: its field, then its position in the file
+typedef struct {
+    uint32_t address;
+    uint8_t lengthNibbles;
+    size_t index;
+} fieldKey;
+
+static int compareField(const void *a, const void *b) {
+    const fieldKey *ka = (const fieldKey *)a;
+    const fieldKey *kb = (const fieldKey *)b;
+
+    if (ka->address != kb->address) {
+        return (ka->address < kb->address) ? -1 : 1;
+    }
+    if (ka->lengthNibbles != kb->lengthNibbles) {
+        return (ka->lengthNibbles < kb->lengthNibbles) ? -1 : 1;
+    }
+    return (ka->index < kb->index) ? -1 : (ka->index > kb->index);
+}
+
+// Position in the file of the first M record of the first field (in file
+// order) whose net change leaves the model, or log->count if there is none
+static size_t fieldViolation(fixupLog *log, const objFile *obj, int32_t R) {
+    fieldKey *keys = (fieldKey *)malloc(log->count * sizeof(*keys));
+    size_t worst = log->count;
+
+    if (!keys) {
+        fixupLogFail(log, "Out of memory.");
+    }
+    for (size_t i = 0; i < log->count; i++) {
+        keys[i].address = obj->modRecords[i].address;
+        keys[i].lengthNibbles = obj->modRecords[i].lengthNibbles;
+        keys[i].index = i;
+    }
+    qsort(keys, log->count, sizeof(*keys), compareField);
+
+    for (size_t g = 0; g < log->count; ) {
+        size_t first = keys[g].index;
+        int64_t net = 0;
+        size_t k = g;
+
+        while (k < log->count && keys[k].address == keys[g].address &&
+               keys[k].lengthNibbles == keys[g].lengthNibbles) {
+            net += (obj->modRecords[keys[k].index].sign == '-') ? -1 : 1;
+            k++;
+        }
+
+        uint64_t before = log->before[first];
+        uint64_t value = (uint64_t)((int64_t)before + net * (int64_t)R);
+        if (((value ^ before) >> log->limit[first]) != 0 && first < worst) {
+            worst = first;
+        }
+        g = k;
+    }
+
+    free(keys);
+    return worst;
+}
+
+void addrModelCheckFixups(const addressModel *model, fixupLog *log, const objFile *obj,
+                          int32_t R, const char *who) {
+    uint32_t acc = 0;
+
+    for (size_t i = 0; i < log->count; i++) {
+        acc |= (log->after[i] ^ log->before[i]) >> log->limit[i];
+    }
+    if (acc == 0) {
+        return;
+    }
+
+    size_t bad = fieldViolation(log, obj, R);
+    if (bad < log->count) {
+        const modRecord *m = &obj->modRecords[bad];
+        static _Thread_local char msg[160]; // fatalMessage() keeps pointing here
+        snprintf(msg, sizeof(msg), "%s: line %u: M record field at %06X leaves the %u-bit %s address space",
+                 who, (unsigned int)m->line, (unsigned int)((m->address + (uint32_t)R) & 0xFFFFFFU),
+                 (unsigned int)model->addrBits, model->name);
+        fixupLogFail(log, msg);
+    }
+}
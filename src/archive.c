@@ -0,0 +1,381 @@
+#include "archive.h"
+#include "memory.h"
+#include "objFile.h"
+#include "util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define ARCHIVE_HAVE_MMAP 1
+#endif
+
+/**
+ * Implementation of indexed object archives.
+ *
+ * This file implements:
+ *   - openView() / closeView(): read-only view of a whole file, mapped
+ *     when the platform allows and read into memory otherwise
+ *   - readIndex(): checks the header of a mapped archive and decodes its
+ *     index, rejecting entries that point outside the file
+ *   - archiveWrite(): parses each new object file to get its program name,
+ *     checks that no name is used twice, then writes the member texts,
+ *     the merged and sorted index, and finally the header. An append
+ *     writes a compacted copy (old members, new members, one index) to a
+ *     temp file and renames it over the archive
+ *   - archiveList() and runArchiveLoad(), which work on the mapped
+ *     archive; a named member is found with bsearch() over the index
+ *
+ * Archives hold the object files' text. Members are parsed with
+ * objParseBuffer() straight from the mapping, so loading one member costs
+ * one map of the archive and no per-member open or stat.
+ */
+
+// Decoded index entry
+typedef struct {
+    char name[ARCHIVE_NAME_SIZE]; // NUL padded program name
+    uint64_t offset; // Member text position in the archive
+    uint64_t length; // Member text size in bytes
+} archiveEntry;
+
+// Read-only contents of a file
+typedef struct {
+    uint8_t *data;
+    size_t length;
+    int mapped; // 1 if data is a mmap()ed view
+} fileView;
+
+static void putLe(uint8_t *p, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        p[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+static uint64_t getLe(const uint8_t *p, int bytes) {
+    uint64_t value = 0;
+    for (int i = bytes - 1; i >= 0; i--) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+static int openView(const char *path, fileView *view) {
+    memset(view, 0, sizeof(*view));
+
+#ifdef ARCHIVE_HAVE_MMAP
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return -1;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map != MAP_FAILED) {
+        view->data = (uint8_t *)map;
+        view->length = (size_t)st.st_size;
+        view->mapped = 1;
+        return 0;
+    }
+#endif
+
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        return -1;
+    }
+    size_t capacity = 0;
+    for (;;) {
+        if (view->length == capacity) {
+            capacity = capacity ? capacity * 2 : 4096;
+            uint8_t *temp = (uint8_t *)realloc(view->data, capacity);
+            if (!temp) {
+                free(view->data);
+                fclose(fp);
+                return -1;
+            }
+            view->data = temp;
+        }
+        size_t got = fread(view->data + view->length, 1, capacity - view->length, fp);
+        view->length += got;
+        if (got == 0) {
+            break;
+        }
+    }
+    fclose(fp);
+    return 0;
+}
+
+static void closeView(fileView *view) {
+#ifdef ARCHIVE_HAVE_MMAP
+    if (view->mapped) {
+        munmap(view->data, view->length);
+        view->data = NULL;
+        return;
+    }
+#endif
+    free(view->data);
+    view->data = NULL;
+}
+
+static int compareEntry(const void *a, const void *b) {
+    return memcmp(((const archiveEntry *)a)->name, ((const archiveEntry *)b)->name,
+                  ARCHIVE_NAME_SIZE);
+}
+
+// Decode the index of the archive in view. Returns 0 on success.
+static int readIndex(const fileView *view, archiveEntry **entries, size_t *count) {
+    *entries = NULL;
+    *count = 0;
+
+    if (view->length < ARCHIVE_HEADER_SIZE ||
+        memcmp(view->data, ARCHIVE_MAGIC, ARCHIVE_NAME_SIZE) != 0) {
+        return -1;
+    }
+
+    uint64_t memberCount = getLe(view->data + 8, 4);
+    uint64_t indexOffset = getLe(view->data + 16, 8);
+    if (indexOffset < ARCHIVE_HEADER_SIZE || indexOffset > view->length ||
+        memberCount > (view->length - indexOffset) / ARCHIVE_ENTRY_SIZE) {
+        return -1;
+    }
+
+    archiveEntry *list = (archiveEntry *)malloc((memberCount ? memberCount : 1) * sizeof(*list));
+    if (!list) {
+        return -1;
+    }
+    for (uint64_t i = 0; i < memberCount; i++) {
+        const uint8_t *p = view->data + indexOffset + i * ARCHIVE_ENTRY_SIZE;
+        memcpy(list[i].name, p, ARCHIVE_NAME_SIZE);
+        list[i].offset = getLe(p + 8, 8);
+        list[i].length = getLe(p + 16, 8);
+        if (list[i].offset < ARCHIVE_HEADER_SIZE || list[i].offset > view->length ||
+            list[i].length > view->length - list[i].offset) {
+            free(list);
+            return -1;
+        }
+    }
+
+    *entries = list;
+    *count = (size_t)memberCount;
+    return 0;
+}
+
+int archiveWrite(const char *archivePath, const char *const *paths, size_t count, int append) {
+    archiveEntry *entries = NULL;
+    size_t existing = 0;
+    fileView old; // Archive being appended to; its members are copied over
+
+    memset(&old, 0, sizeof(old));
+    if (append) {
+        if (openView(archivePath, &old) != 0 || readIndex(&old, &entries, &existing) != 0) {
+            fatalPath("Not a readable object archive", archivePath);
+        }
+    }
+
+    size_t total = existing + count;
+    archiveEntry *temp = (archiveEntry *)realloc(entries, (total ? total : 1) * sizeof(*temp));
+    if (!temp) {
+        fatal("Out of memory.");
+    }
+    entries = temp;
+
+    // Pass 1: every new member must parse, and its program name is its key
+    for (size_t i = 0; i < count; i++) {
+        fileView view;
+        objFile obj;
+        archiveEntry *e = &entries[existing + i];
+
+        if (openView(paths[i], &view) != 0 ||
+            objParseBuffer((const char *)view.data, view.length, &obj) != 0) {
+            if (objParseMessage()) {
+                printf("Error: %s\n", objParseMessage());
+            }
+            fatalPath("Failed to parse SCOFF file", paths[i]);
+        }
+        memset(e->name, 0, sizeof(e->name));
+        memcpy(e->name, obj.header.progName, strlen(obj.header.progName));
+        e->length = view.length;
+        objFree(&obj);
+        closeView(&view);
+    }
+
+    // Names must stay unique. Sort a copy, so pass 2 keeps the input order.
+    archiveEntry *sorted = (archiveEntry *)malloc((total ? total : 1) * sizeof(*sorted));
+    if (!sorted) {
+        fatal("Out of memory.");
+    }
+    memcpy(sorted, entries, total * sizeof(*sorted));
+    qsort(sorted, total, sizeof(*sorted), compareEntry);
+    for (size_t i = 1; i < total; i++) {
+        if (compareEntry(&sorted[i - 1], &sorted[i]) == 0) {
+            fatalPath("Duplicate program name in archive", sorted[i].name);
+        }
+    }
+    free(sorted);
+
+    // An append rebuilds the archive in a temp file that replaces it at the
+    // end, so the old index does not stay behind as dead bytes
+    char tempPath[4096];
+    const char *outPath = archivePath;
+    if (append) {
+        if (snprintf(tempPath, sizeof(tempPath), "%s%s", archivePath, ARCHIVE_TEMP_SUFFIX) >=
+            (int)sizeof(tempPath)) {
+            fatalPath("Archive path too long", archivePath);
+        }
+        outPath = tempPath;
+    }
+
+    FILE *fp = fopen(outPath, "wb");
+    if (!fp) {
+        fatalPath("Could not open archive for writing", outPath);
+    }
+
+    uint8_t header[ARCHIVE_HEADER_SIZE];
+    memset(header, 0, sizeof(header));
+    if (fwrite(header, 1, sizeof(header), fp) != sizeof(header)) {
+        fatalPath("Could not write archive", outPath);
+    }
+
+    // Pass 2: member texts, then the index, then the header that points at it
+    for (size_t i = 0; i < existing; i++) {
+        archiveEntry *e = &entries[i];
+        const uint8_t *text = old.data + e->offset;
+
+        e->offset = (uint64_t)ftell(fp);
+        if (fwrite(text, 1, (size_t)e->length, fp) != e->length) {
+            fatalPath("Could not write archive", outPath);
+        }
+    }
+    closeView(&old);
+    for (size_t i = 0; i < count; i++) {
+        fileView view;
+        archiveEntry *e = &entries[existing + i];
+
+        if (openView(paths[i], &view) != 0 || view.length != e->length) {
+            fatalPath("Object file changed while archiving", paths[i]);
+        }
+        e->offset = (uint64_t)ftell(fp);
+        if (fwrite(view.data, 1, view.length, fp) != view.length) {
+            fatalPath("Could not write archive", outPath);
+        }
+        closeView(&view);
+    }
+
+    qsort(entries, total, sizeof(*entries), compareEntry);
+    uint64_t indexOffset = (uint64_t)ftell(fp);
+    for (size_t i = 0; i < total; i++) {
+        uint8_t raw[ARCHIVE_ENTRY_SIZE];
+        memcpy(raw, entries[i].name, ARCHIVE_NAME_SIZE);
+        putLe(raw + 8, entries[i].offset, 8);
+        putLe(raw + 16, entries[i].length, 8);
+        if (fwrite(raw, 1, sizeof(raw), fp) != sizeof(raw)) {
+            fatalPath("Could not write archive", outPath);
+        }
+    }
+
+    memcpy(header, ARCHIVE_MAGIC, ARCHIVE_NAME_SIZE);
+    putLe(header + 8, total, 4);
+    putLe(header + 16, indexOffset, 8);
+    if (fflush(fp) != 0 || fseek(fp, 0, SEEK_SET) != 0 ||
+        fwrite(header, 1, sizeof(header), fp) != sizeof(header) || fclose(fp) != 0) {
+        remove(outPath);
+        fatalPath("Could not write archive", outPath);
+    }
+    if (append && rename(tempPath, archivePath) != 0) {
+        remove(tempPath);
+        fatalPath("Could not replace archive", archivePath);
+    }
+
+    printf("%zu members in %s (%zu added)\n", total, archivePath, count);
+    free(entries);
+    return 0;
+}
+
+int archiveList(const char *archivePath) {
+    fileView view;
+    archiveEntry *entries;
+    size_t count;
+
+    if (openView(archivePath, &view) != 0 || readIndex(&view, &entries, &count) != 0) {
+        fatalPath("Not a readable object archive", archivePath);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        printf("%-6.6s %12llu %8llu\n", entries[i].name,
+               (unsigned long long)entries[i].offset, (unsigned long long)entries[i].length);
+    }
+    printf("%zu members\n", count);
+
+    free(entries);
+    closeView(&view);
+    return 0;
+}
+
+int runArchiveLoad(const char *archivePath, const char *member, uint32_t reloc,
+                   machineType machine, outputMode mode) {
+    fileView view;
+    archiveEntry *entries;
+    size_t count;
+    size_t first = 0, last = 0; // Members [first, last) are loaded
+
+    if (openView(archivePath, &view) != 0 || readIndex(&view, &entries, &count) != 0) {
+        fatalPath("Not a readable object archive", archivePath);
+    }
+
+    if (member) {
+        archiveEntry key;
+        memset(&key, 0, sizeof(key));
+        if (strlen(member) >= ARCHIVE_NAME_SIZE) {
+            fatalPath("Program not found in archive", member);
+        }
+        memcpy(key.name, member, strlen(member));
+
+        const archiveEntry *found = (const archiveEntry *)bsearch(&key, entries, count,
+                                                                  sizeof(*entries), compareEntry);
+        if (!found) {
+            fatalPath("Program not found in archive", member);
+        }
+        first = (size_t)(found - entries);
+        last = first + 1;
+    }
+    else {
+        last = count;
+    }
+
+    for (size_t i = first; i < last; i++) {
+        objFile obj;
+        const char *text = (const char *)view.data + entries[i].offset;
+
+        if (objParseBuffer(text, (size_t)entries[i].length, &obj) != 0) {
+            if (objParseMessage()) {
+                printf("Error: %s\n", objParseMessage());
+            }
+            fatal("Failed to parse SCOFF file.");
+        }
+        memInit();
+        relocateObject(&obj, reloc, machine);
+        if (mode == OUTPUT_DELTA) {
+            printDeltaRecords(&obj, stdout);
+        }
+        else {
+            printRelocatedRecords(&obj, stdout);
+        }
+        objFree(&obj);
+    }
+
+    free(entries);
+    closeView(&view);
+    return 0;
+}
@@ -0,0 +1,258 @@
+#include "audit.h"
+#include "trace.h"
+
+/**
+ * Implementation of the SIC/XE fixup coverage audit.
+ *
+ * This file implements:
+ *   - The opcode table: one entry per possible first byte, giving the
+ *     instruction format. Format 3/4 opcodes fill four entries each (the
+ *     n and i bits are the low two bits of the byte); FORMAT3 there means
+ *     "format 3, or format 4 when the e bit is set"
+ *   - auditSicXE(), which:
+ *       * Sorts the T records and the M records by address
+ *       * Decodes each run of contiguous T records into one byte buffer
+ *       * Walks the buffer instruction by instruction, checking every
+ *         format 4 instruction for a matching 5-nibble M record
+ *       * Checks every 5-nibble M record in the run against the bytes
+ *         around it
+ *
+ * The M records are visited with cursors that only move forward, so the
+ * whole audit is one pass over the text after the two sorts.
+ */
+
+#define F34(op) [(op)] = FORMAT3, [(op) + 1] = FORMAT3, [(op) + 2] = FORMAT3, [(op) + 3] = FORMAT3
+
+static const uint8_t opcodeFormat[256] = {
+    // Format 1
+    [0xC4] = FORMAT1, [0xC0] = FORMAT1, [0xF4] = FORMAT1, // FIX, FLOAT, HIO
+    [0xC8] = FORMAT1, [0xF0] = FORMAT1, [0xF8] = FORMAT1, // NORM, SIO, TIO
+    // Format 2
+    [0x90] = FORMAT2, [0xB4] = FORMAT2, [0xA0] = FORMAT2, // ADDR, CLEAR, COMPR
+    [0x9C] = FORMAT2, [0x98] = FORMAT2, [0xAC] = FORMAT2, // DIVR, MULR, RMO
+    [0xA4] = FORMAT2, [0xA8] = FORMAT2, [0x94] = FORMAT2, // SHIFTL, SHIFTR, SUBR
+    [0xB0] = FORMAT2, [0xB8] = FORMAT2,                   // SVC, TIXR
+    // Format 3/4
+    F34(0x18), F34(0x58), F34(0x40), F34(0x28), F34(0x88), // ADD, ADDF, AND, COMP, COMPF
+    F34(0x24), F34(0x64), F34(0x3C), F34(0x30), F34(0x34), // DIV, DIVF, J, JEQ, JGT
+    F34(0x38), F34(0x48), F34(0x00), F34(0x68), F34(0x50), // JLT, JSUB, LDA, LDB, LDCH
+    F34(0x70), F34(0x08), F34(0x6C), F34(0x74), F34(0x04), // LDF, LDL, LDS, LDT, LDX
+    F34(0xD0), F34(0x20), F34(0x60), F34(0x44), F34(0xD8), // LPS, MUL, MULF, OR, RD
+    F34(0x4C), F34(0xEC), F34(0x0C), F34(0x78), F34(0x54), // RSUB, SSK, STA, STB, STCH
+    F34(0x80), F34(0xD4), F34(0x14), F34(0x7C), F34(0xE8), // STF, STI, STL, STS, STSW
+    F34(0x84), F34(0x10), F34(0x1C), F34(0x5C), F34(0xE0), // STT, STX, SUB, SUBF, TD
+    F34(0x2C), F34(0xDC),                                  // TIX, WD
+};
+
+SicXeFormat sicxeFormat(uint8_t opcode) {
+    return (SicXeFormat)opcodeFormat[opcode];
+}
+
+// M record reduced to what the audit needs
+typedef struct {
+    uint32_t address;
+    uint8_t lengthNibbles;
+    uint32_t line;
+} auditMod;
+
+static int compareText(const void *a, const void *b) {
+    const textRecord *ta = *(const textRecord *const *)a;
+    const textRecord *tb = *(const textRecord *const *)b;
+
+    if (ta->address != tb->address) {
+        return (ta->address < tb->address) ? -1 : 1;
+    }
+    return 0;
+}
+
+static int compareMod(const void *a, const void *b) {
+    const auditMod *ma = (const auditMod *)a;
+    const auditMod *mb = (const auditMod *)b;
+
+    if (ma->address != mb->address) {
+        return (ma->address < mb->address) ? -1 : 1;
+    }
+    return 0;
+}
+
+// First M record at or after addr with the given width, starting at *cursor.
+// The cursor only moves forward, so addr must never decrease between calls.
+static const auditMod *nextMod(const auditMod *mods, size_t count, size_t *cursor,
+                               uint32_t addr, uint8_t nibbles) {
+    while (*cursor < count &&
+           (mods[*cursor].address < addr || mods[*cursor].lengthNibbles != nibbles)) {
+        (*cursor)++;
+    }
+    return (*cursor < count) ? &mods[*cursor] : NULL;
+}
+
+// Line of the T record (of a run starting at first) that holds address addr
+static uint32_t lineOf(textRecord *const *first, size_t count, uint32_t addr) {
+    uint32_t line = first[0]->line;
+
+    for (size_t i = 0; i < count && first[i]->address <= addr; i++) {
+        line = first[i]->line;
+    }
+    return line;
+}
+
+int auditSicXE(const objFile *obj, FILE *report) {
+    if (!obj || obj->textCount == 0) {
+        return 0;
+    }
+
+    uint64_t spanStart = traceNow();
+    textRecord **text = (textRecord **)malloc(obj->textCount * sizeof(*text));
+    auditMod *mods = (auditMod *)malloc((obj->modCount + 1) * sizeof(*mods));
+    uint8_t *code = NULL;
+    size_t codeCapacity = 0;
+    int findings = 0;
+
+    if (!text || !mods) {
+        free(text);
+        free(mods);
+        return -1;
+    }
+
+    size_t textCount = 0;
+    for (size_t i = 0; i < obj->textCount; i++) {
+        if (obj->textRecords[i].length > 0) {
+            text[textCount++] = &obj->textRecords[i];
+        }
+    }
+    for (size_t i = 0; i < obj->modCount; i++) {
+        mods[i].address = obj->modRecords[i].address;
+        mods[i].lengthNibbles = obj->modRecords[i].lengthNibbles;
+        mods[i].line = obj->modRecords[i].line;
+    }
+    qsort(text, textCount, sizeof(*text), compareText);
+    qsort(mods, obj->modCount, sizeof(*mods), compareMod);
+
+    uint32_t progStart = obj->header.startAddress;
+    uint32_t progEnd = progStart + obj->header.programLength;
+    size_t fieldCursor = 0; // 5-nibble M records, by address field
+    size_t anchorCursor = 0; // 5-nibble M records, by instruction start
+    size_t wordCursor = 0; // 6-nibble M records (data words)
+    size_t spuriousCursor = 0; // 5-nibble M records checked against the bytes
+
+    for (size_t r = 0; r < textCount; ) {
+        // Collect one run of touching T records into code[]
+        size_t first = r;
+        uint32_t runStart = text[r]->address;
+        size_t runLength = 0;
+        do {
+            const textRecord *t = text[r];
+            if (runLength + t->length > codeCapacity) {
+                codeCapacity = (runLength + t->length) * 2;
+                uint8_t *temp = (uint8_t *)realloc(code, codeCapacity);
+                if (!temp) {
+                    free(code);
+                    free(text);
+                    free(mods);
+                    return -1;
+                }
+                code = temp;
+            }
+            if (t->decoded) {
+                memcpy(code + runLength, t->bytes, t->length);
+            }
+            else if (objDecodeHex(t->hexText, t->length, code + runLength) != 0) {
+                free(code);
+                free(text);
+                free(mods);
+                return -1;
+            }
+            runLength += t->length;
+            r++;
+        } while (r < textCount && text[r]->address == runStart + runLength);
+        uint32_t runEnd = runStart + (uint32_t)runLength;
+
+        // Walk the instructions of the run
+        size_t pos = 0;
+        while (pos < runLength) {
+            uint32_t addr = runStart + (uint32_t)pos;
+
+            // A WORD named by a 6-nibble M record is data
+            const auditMod *word = nextMod(mods, obj->modCount, &wordCursor, addr, 6);
+            if (word && word->address == addr) {
+                pos += 3;
+                continue;
+            }
+
+            uint8_t op = code[pos];
+            size_t size = 1; // Unknown bytes are skipped one at a time
+            switch (sicxeFormat(op)) {
+            case FORMAT1:
+                size = 1;
+                break;
+            case FORMAT2:
+                size = 2;
+                break;
+            case FORMAT3:
+            case FORMAT4:
+                if ((op & SICXE_NI_MASK) != 0 && pos + 1 < runLength &&
+                    (code[pos + 1] & SICXE_E_BIT)) {
+                    size = 4;
+                }
+                else {
+                    size = 3;
+                }
+                break;
+            default:
+                break;
+            }
+
+            // Re-synchronize on a known format 4 instruction inside this one
+            const auditMod *anchor = nextMod(mods, obj->modCount, &anchorCursor, addr + 2,
+                                             SICXE_FORMAT4_NIBBLES);
+            if (anchor && anchor->address - 1 > addr && anchor->address - 1 < addr + size) {
+                pos = anchor->address - 1 - runStart;
+                continue;
+            }
+
+            if (size == 4 && pos + 4 <= runLength) {
+                uint32_t target = ((uint32_t)(code[pos + 1] & 0x0F) << 16) |
+                                  ((uint32_t)code[pos + 2] << 8) | code[pos + 3];
+                const auditMod *field = nextMod(mods, obj->modCount, &fieldCursor, addr + 1,
+                                                SICXE_FORMAT4_NIBBLES);
+                int hasFixup = field && field->address == addr + 1;
+
+                if (!hasFixup && (op & SICXE_NI_MASK) != SICXE_NI_IMMEDIATE &&
+                    target >= progStart && target < progEnd) {
+                    findings++;
+                    if (report) {
+                        fprintf(report, "Warning: line %u: format 4 instruction at %06X targets %06X "
+                                "but has no M record (expected M%06X05+)\n",
+                                (unsigned int)lineOf(text + first, r - first, addr),
+                                (unsigned int)addr, (unsigned int)target, (unsigned int)(addr + 1));
+                    }
+                }
+            }
+            pos += size;
+        }
+
+        // Every 5-nibble M record in this run must sit on a format 4 address field
+        const auditMod *m;
+        while ((m = nextMod(mods, obj->modCount, &spuriousCursor, runStart,
+                            SICXE_FORMAT4_NIBBLES)) != NULL && m->address < runEnd) {
+            size_t at = m->address - runStart;
+            int ok = at >= 1 && sicxeFormat(code[at - 1]) == FORMAT3 &&
+                     (code[at - 1] & SICXE_NI_MASK) != 0 && (code[at] & SICXE_E_BIT);
+            if (!ok) {
+                findings++;
+                if (report) {
+                    fprintf(report, "Warning: line %u: M record at %06X does not point at the "
+                            "address field of a format 4 instruction\n",
+                            (unsigned int)m->line, (unsigned int)m->address);
+                }
+            }
+            spuriousCursor++;
+        }
+    }
+
+    traceSpan("audit", obj->header.progName, spanStart, 0, obj->modCount);
+    free(code);
+    free(text);
+    free(mods);
+    return findings;
+}
@@ -0,0 +1,57 @@
+#include "check.h"
+#include "objFile.h"
+#include "parallel.h"
+#include "util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * Implementation of the --check preflight mode.
+ *
+ * This file implements:
+ *   - runCheck(), which runs objCheckFile() over every path on a pool
+ *     of worker threads, storing one result per file, and then prints
+ *     the results in input order so the report is deterministic
+ *
+ * objCheckFile() does the H/T/M/E structure, range and layout checks of
+ * objParseFile() and validates the hex digits, but does not allocate
+ * record arrays, decode payload bytes, relocate or print records.
+ */
+
+typedef struct {
+    const char *const *paths; // Files to check
+    int *results; // 0 = pass, -1 = fail, one per path
+} checkJob;
+
+static void checkOne(size_t index, void *ctx) {
+    checkJob *job = (checkJob *)ctx;
+    job->results[index] = objCheckFile(job->paths[index]);
+}
+
+int runCheck(const char *const *paths, size_t count, unsigned int jobs) {
+    checkJob job;
+    size_t failed = 0;
+
+    job.paths = paths;
+    job.results = (int *)calloc(count ? count : 1, sizeof(int));
+    if (!job.results) {
+        fatal("Out of memory.");
+    }
+
+    parallelFor(count, jobs, checkOne, &job);
+
+    for (size_t i = 0; i < count; i++) {
+        if (job.results[i] == 0) {
+            printf("PASS %s\n", paths[i]);
+        }
+        else {
+            printf("FAIL %s\n", paths[i]);
+            failed++;
+        }
+    }
+    printf("%zu files checked, %zu failed\n", count, failed);
+
+    free(job.results);
+    return failed ? 1 : 0;
+}
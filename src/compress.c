@@ -0,0 +1,225 @@
+#ifdef __linux__
+#define _GNU_SOURCE // pipe2()
+#endif
+
+#include "compress.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#define COMPRESS_HAVE_SPAWN 1
+extern char **environ;
+#endif
+
+/**
+ * Implementation of compressed input and output through gzip / zstd.
+ *
+ * This file implements:
+ *   - compressDetect(): gzip starts with 1F 8B, a zstd frame with
+ *     28 B5 2F FD
+ *   - spawnTool(): starts the tool with one end of a pipe as its stdin or
+ *     stdout and the file as the other; the loader keeps the other pipe
+ *     end. Both ends are created close-on-exec (pipe2()), so a tool that
+ *     another thread starts at the same time inherits neither of them and
+ *     can not hold the pipe open past the end of this tool
+ *   - compressOpenRead() / compressOpenWrite(): "gzip -dc <file>" or
+ *     "zstd -dcq <file>" feeding the loader, and "gzip -c" or "zstd -cq"
+ *     writing the file
+ *   - compressClose(): closes the loader's end and reaps the tool
+ *   - compressReadFile(): reads a decompressing stream to the end into a
+ *     growing buffer
+ */
+
+compressFormat compressDetect(const void *head, size_t length) {
+    const uint8_t *p = (const uint8_t *)head;
+
+    if (length >= 2 && p[0] == 0x1F && p[1] == 0x8B) {
+        return COMPRESS_GZIP;
+    }
+    if (length >= 4 && p[0] == 0x28 && p[1] == 0xB5 && p[2] == 0x2F && p[3] == 0xFD) {
+        return COMPRESS_ZSTD;
+    }
+    return COMPRESS_NONE;
+}
+
+static int hasSuffix(const char *s, const char *suffix) {
+    size_t n = strlen(s), k = strlen(suffix);
+    return n > k && strcmp(s + n - k, suffix) == 0;
+}
+
+compressFormat compressForPath(const char *path) {
+    if (hasSuffix(path, ".gz")) {
+        return COMPRESS_GZIP;
+    }
+    if (hasSuffix(path, ".zst")) {
+        return COMPRESS_ZSTD;
+    }
+    return COMPRESS_NONE;
+}
+
+#ifdef COMPRESS_HAVE_SPAWN
+
+// Start the tool for format. With decompress, it reads path and writes the
+// pipe; otherwise it reads the pipe and writes path. Returns the loader's
+// end of the pipe, or -1.
+static int spawnTool(const char *path, compressFormat format, int decompress, pid_t *pid) {
+    const char *tool = (format == COMPRESS_ZSTD) ? "zstd" : "gzip";
+    const char *flags = (format == COMPRESS_ZSTD) ? (decompress ? "-dcq" : "-cq")
+                                                  : (decompress ? "-dc" : "-c");
+    char *argv[5];
+    int fds[2];
+
+    argv[0] = (char *)tool;
+    argv[1] = (char *)flags;
+    argv[2] = decompress ? (char *)"--" : NULL;
+    argv[3] = (char *)path;
+    argv[4] = NULL;
+
+#ifdef __linux__
+    if (pipe2(fds, O_CLOEXEC) != 0) {
+        return -1;
+    }
+#else
+    if (pipe(fds) != 0) {
+        return -1;
+    }
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+#endif
+    int mine = decompress ? fds[0] : fds[1];
+    int theirs = decompress ? fds[1] : fds[0];
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, theirs, decompress ? STDOUT_FILENO : STDIN_FILENO);
+    if (!decompress) {
+        posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, path,
+                                         O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    }
+
+    int error = posix_spawnp(pid, tool, &actions, NULL, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(theirs);
+    if (error != 0) {
+        close(mine);
+        return -1;
+    }
+    return mine;
+}
+
+static int openStream(const char *path, compressFormat format, int decompress,
+                      compressStream *stream) {
+    pid_t pid;
+    int fd = spawnTool(path, format, decompress, &pid);
+
+    stream->fp = NULL;
+    stream->pid = 0;
+    if (fd < 0) {
+        return -1;
+    }
+    stream->fp = fdopen(fd, decompress ? "rb" : "wb");
+    stream->pid = (long)pid;
+    if (!stream->fp) {
+        close(fd);
+        compressClose(stream);
+        return -1;
+    }
+    return 0;
+}
+
+int compressOpenRead(const char *path, compressFormat format, compressStream *stream) {
+    return openStream(path, format, 1, stream);
+}
+
+int compressOpenWrite(const char *path, compressFormat format, compressStream *stream) {
+    return openStream(path, format, 0, stream);
+}
+
+int compressClose(compressStream *stream) {
+    int result = 0;
+    int status;
+
+    if (stream->fp && fclose(stream->fp) != 0) {
+        result = -1;
+    }
+    stream->fp = NULL;
+    if (stream->pid > 0) {
+        while (waitpid((pid_t)stream->pid, &status, 0) < 0) {
+            if (errno != EINTR) {
+                return -1;
+            }
+        }
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            result = -1;
+        }
+    }
+    stream->pid = 0;
+    return result;
+}
+
+#else
+
+int compressOpenRead(const char *path, compressFormat format, compressStream *stream) {
+    (void)path;
+    (void)format;
+    stream->fp = NULL;
+    stream->pid = 0;
+    return -1;
+}
+
+int compressOpenWrite(const char *path, compressFormat format, compressStream *stream) {
+    return compressOpenRead(path, format, stream);
+}
+
+int compressClose(compressStream *stream) {
+    (void)stream;
+    return -1;
+}
+
+#endif
+
+int compressReadFile(const char *path, compressFormat format, char **data, size_t *length) {
+    compressStream stream;
+    char *buf = NULL;
+    size_t used = 0, capacity = 0;
+
+    *data = NULL;
+    *length = 0;
+    if (compressOpenRead(path, format, &stream) != 0) {
+        return -1;
+    }
+
+    for (;;) {
+        if (used == capacity) {
+            capacity = capacity ? capacity * 2 : 64U * 1024U;
+            char *temp = (char *)realloc(buf, capacity);
+            if (!temp) {
+                free(buf);
+                compressClose(&stream);
+                return -1;
+            }
+            buf = temp;
+        }
+        size_t got = fread(buf + used, 1, capacity - used, stream.fp);
+        used += got;
+        if (got == 0) {
+            break;
+        }
+    }
+
+    if (compressClose(&stream) != 0) {
+        free(buf);
+        return -1;
+    }
+    *data = buf;
+    *length = used;
+    return 0;
+}
@@ -0,0 +1,355 @@
+#include "emit.h"
+#include "compress.h"
+#include "util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Implementation of the fan-out emitter.
+ *
+ * This file implements:
+ *   - emitSink: one open destination with its own output buffer. Records
+ *     are formatted straight into the buffer (sinkReserve() /
+ *     sinkCommit()), so a line never goes through an intermediate string
+ *   - One record writer per format:
+ *       * scoffRecord(): "T" + address + length + payload, copying the
+ *         original hex text of records relocation never decoded
+ *       * binRecord(): the record bytes at (address - lowest address);
+ *         forward gaps are zero filled, so the image can go to a pipe as
+ *         long as the T records are in address order
+ *       * ihexRecord(): type 00 lines of up to EMIT_LINE_BYTES bytes, with
+ *         a type 04 line whenever the upper 16 address bits change
+ *       * srecRecord(): S2 lines (24-bit addresses) of up to
+ *         EMIT_LINE_BYTES bytes
+ *   - Targets named *.gz or *.zst are written through gzip / zstd
+ *     (compress.h); the sink's buffer feeds the compressor's pipe
+ *   - emitRecords(), which opens every target, writes the format headers,
+ *     walks the T records once, then writes the trailers (E record, Intel
+ *     HEX type 05 + 01, S8) and closes the sinks
+ */
+
+typedef struct {
+    emitFormat format;
+    const char *path;
+    FILE *fp;
+    compressStream compressor; // Owns fp when the path ends in .gz or .zst
+    size_t used; // Bytes waiting in buffer
+    uint64_t position; // bin: file offset of the next byte written
+    uint64_t end; // bin: size of the image written so far
+    uint32_t upper; // ihex: upper 16 address bits now in effect
+    char buffer[EMIT_BUFFER_SIZE];
+} emitSink;
+
+static const char hexDigits[] = "0123456789ABCDEF";
+
+static void sinkFlush(emitSink *s) {
+    if (s->used > 0 && fwrite(s->buffer, 1, s->used, s->fp) != s->used) {
+        fatalPath("Could not write emit output", s->path);
+    }
+    s->used = 0;
+}
+
+// Room for at least n bytes at the end of the buffer (n <= EMIT_BUFFER_SIZE)
+static char *sinkReserve(emitSink *s, size_t n) {
+    if (s->used + n > sizeof(s->buffer)) {
+        sinkFlush(s);
+    }
+    return s->buffer + s->used;
+}
+
+static void sinkCommit(emitSink *s, const char *end) {
+    s->used = (size_t)(end - s->buffer);
+}
+
+static void sinkWrite(emitSink *s, const void *data, size_t n) {
+    memcpy(sinkReserve(s, n), data, n);
+    s->used += n;
+}
+
+// Write value as 'digits' uppercase hex digits at p
+static char *putHex(char *p, uint32_t value, int digits) {
+    for (int i = digits - 1; i >= 0; i--) {
+        p[i] = hexDigits[value & 0xFU];
+        value >>= 4;
+    }
+    return p + digits;
+}
+
+// Write one byte as two hex digits and add it to the line checksum
+static char *putByte(char *p, uint8_t value, uint8_t *sum) {
+    *sum = (uint8_t)(*sum + value);
+    *p++ = hexDigits[value >> 4];
+    *p++ = hexDigits[value & 0xFU];
+    return p;
+}
+
+static void scoffRecord(emitSink *s, const textRecord *t, const uint8_t *bytes) {
+    char *p = sinkReserve(s, 10U + (size_t)t->length * 2U);
+
+    *p++ = 'T';
+    p = putHex(p, t->address, 6);
+    p = putHex(p, t->length, 2);
+    if (!t->decoded) {
+        // Untouched record: copy the original hex payload verbatim
+        memcpy(p, t->hexText, (size_t)t->length * 2U);
+        p += (size_t)t->length * 2U;
+    }
+    else {
+        for (size_t j = 0; j < t->length; j++) {
+            *p++ = hexDigits[bytes[j] >> 4];
+            *p++ = hexDigits[bytes[j] & 0xFU];
+        }
+    }
+    *p++ = '\n';
+    sinkCommit(s, p);
+}
+
+static void binRecord(emitSink *s, uint64_t offset, const uint8_t *bytes, size_t length) {
+    uint64_t next = s->position;
+
+    if (offset > next && next == s->end && offset - next <= sizeof(s->buffer)) {
+        // Short gap at the end of the image: zero fill in the buffer
+        size_t gap = (size_t)(offset - next);
+        memset(sinkReserve(s, gap), 0, gap);
+        s->used += gap;
+    }
+    else if (offset != next) {
+        sinkFlush(s);
+        if (fseek(s->fp, (long)offset, SEEK_SET) != 0) {
+            // Not seekable (a pipe): only forward gaps can be written
+            if (offset < next || next != s->end) {
+                fatalPath("Flat binary output needs T records in address order", s->path);
+            }
+            while (next < offset) {
+                size_t gap = (offset - next > sizeof(s->buffer)) ? sizeof(s->buffer)
+                                                                 : (size_t)(offset - next);
+                memset(sinkReserve(s, gap), 0, gap);
+                s->used += gap;
+                next += gap;
+            }
+        }
+    }
+    sinkWrite(s, bytes, length);
+    s->position = offset + length;
+    if (s->position > s->end) {
+        s->end = s->position;
+    }
+}
+
+// One Intel HEX line: ':' count address type data checksum
+static void ihexLine(emitSink *s, uint16_t address, uint8_t type, const uint8_t *data,
+                     size_t length) {
+    char *p = sinkReserve(s, 12U + length * 2U);
+    uint8_t sum = 0;
+
+    *p++ = ':';
+    p = putByte(p, (uint8_t)length, &sum);
+    p = putByte(p, (uint8_t)(address >> 8), &sum);
+    p = putByte(p, (uint8_t)address, &sum);
+    p = putByte(p, type, &sum);
+    for (size_t j = 0; j < length; j++) {
+        p = putByte(p, data[j], &sum);
+    }
+    p = putByte(p, (uint8_t)(0x100U - sum), &sum);
+    *p++ = '\n';
+    sinkCommit(s, p);
+}
+
+static void ihexRecord(emitSink *s, uint32_t address, const uint8_t *bytes, size_t length) {
+    while (length > 0) {
+        if ((address >> 16) != s->upper) {
+            uint8_t upper[2] = {(uint8_t)(address >> 24), (uint8_t)(address >> 16)};
+            s->upper = address >> 16;
+            ihexLine(s, 0, 0x04, upper, sizeof(upper));
+        }
+        // A line must not cross a 64KB boundary
+        size_t n = 0x10000U - (address & 0xFFFFU);
+        if (n > length) {
+            n = length;
+        }
+        if (n > EMIT_LINE_BYTES) {
+            n = EMIT_LINE_BYTES;
+        }
+        ihexLine(s, (uint16_t)address, 0x00, bytes, n);
+        address += (uint32_t)n;
+        bytes += n;
+        length -= n;
+    }
+}
+
+// One S-record line: 'S' type count address data checksum
+static void srecLine(emitSink *s, char type, uint32_t address, int addressBytes,
+                     const uint8_t *data, size_t length) {
+    char *p = sinkReserve(s, 12U + length * 2U);
+    uint8_t sum = 0;
+
+    *p++ = 'S';
+    *p++ = type;
+    p = putByte(p, (uint8_t)(addressBytes + length + 1), &sum);
+    for (int k = addressBytes - 1; k >= 0; k--) {
+        p = putByte(p, (uint8_t)(address >> (8 * k)), &sum);
+    }
+    for (size_t j = 0; j < length; j++) {
+        p = putByte(p, data[j], &sum);
+    }
+    p = putByte(p, (uint8_t)~sum, &sum);
+    *p++ = '\n';
+    sinkCommit(s, p);
+}
+
+static void srecRecord(emitSink *s, uint32_t address, const uint8_t *bytes, size_t length) {
+    while (length > 0) {
+        size_t n = (length > EMIT_LINE_BYTES) ? EMIT_LINE_BYTES : length;
+        srecLine(s, '2', address, 3, bytes, n);
+        address += (uint32_t)n;
+        bytes += n;
+        length -= n;
+    }
+}
+
+int emitParseTarget(const char *spec, emitTarget *out) {
+    static const struct {
+        const char *name;
+        emitFormat format;
+    } formats[] = {
+        {"scoff", EMIT_SCOFF}, {"bin", EMIT_BIN}, {"ihex", EMIT_IHEX}, {"srec", EMIT_SREC},
+    };
+    const char *colon = strchr(spec, ':');
+
+    if (!colon || colon[1] == '\0') {
+        return -1;
+    }
+    for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+        if (strlen(formats[i].name) == (size_t)(colon - spec) &&
+            strncmp(spec, formats[i].name, (size_t)(colon - spec)) == 0) {
+            out->format = formats[i].format;
+            out->path = colon + 1;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+void emitRecords(const objFile *obj, const emitTarget *targets, size_t count) {
+    emitSink *sinks = (emitSink *)malloc((count ? count : 1) * sizeof(*sinks));
+    int needBytes = 0; // 1 if a sink needs the bytes of undecoded records
+    uint32_t base = UINT32_MAX; // Address of the first byte of the flat binary
+
+    if (!sinks) {
+        fatal("Out of memory.");
+    }
+
+    for (size_t k = 0; k < count; k++) {
+        emitSink *s = &sinks[k];
+        s->format = targets[k].format;
+        s->path = targets[k].path;
+        s->used = 0;
+        s->position = 0;
+        s->end = 0;
+        s->upper = 0;
+        s->compressor.fp = NULL;
+        compressFormat compressed = compressForPath(s->path);
+        if (strcmp(s->path, "-") == 0) {
+            s->fp = stdout;
+        }
+        else if (compressed != COMPRESS_NONE) {
+            if (compressOpenWrite(s->path, compressed, &s->compressor) != 0) {
+                fatalPath("Could not start the compressor for emit output", s->path);
+            }
+            s->fp = s->compressor.fp;
+        }
+        else if ((s->fp = fopen(s->path, "wb")) == NULL) {
+            fatalPath("Could not open emit output", s->path);
+        }
+        if (s->format != EMIT_SCOFF) {
+            needBytes = 1;
+        }
+        if (s->format == EMIT_BIN && base == UINT32_MAX) {
+            for (size_t i = 0; i < obj->textCount; i++) {
+                if (obj->textRecords[i].length > 0 && obj->textRecords[i].address < base) {
+                    base = obj->textRecords[i].address;
+                }
+            }
+        }
+        if (s->format == EMIT_SREC) {
+            srecLine(s, '0', 0, 2, (const uint8_t *)obj->header.progName,
+                     strlen(obj->header.progName));
+        }
+    }
+
+    // The single traversal: every sink sees each record once, in file order
+    for (size_t i = 0; i < obj->textCount; i++) {
+        const textRecord *t = &obj->textRecords[i];
+        const uint8_t *bytes = t->bytes;
+        uint8_t decoded[MAX_T_BYTES];
+
+        if (!t->decoded && needBytes) {
+            if (objDecodeHex(t->hexText, t->length, decoded) != 0) {
+                fatal("Failed to decode text record.");
+            }
+            bytes = decoded;
+        }
+
+        for (size_t k = 0; k < count; k++) {
+            emitSink *s = &sinks[k];
+            switch (s->format) {
+            case EMIT_SCOFF:
+                scoffRecord(s, t, bytes);
+                break;
+            case EMIT_BIN:
+                if (t->length > 0) {
+                    binRecord(s, (uint64_t)(t->address - base), bytes, t->length);
+                }
+                break;
+            case EMIT_IHEX:
+                ihexRecord(s, t->address, bytes, t->length);
+                break;
+            case EMIT_SREC:
+                srecRecord(s, t->address, bytes, t->length);
+                break;
+            }
+        }
+    }
+
+    uint32_t entry = obj->endRecord.firstExecAddress;
+    for (size_t k = 0; k < count; k++) {
+        emitSink *s = &sinks[k];
+        switch (s->format) {
+        case EMIT_SCOFF: {
+            char *p = sinkReserve(s, 8);
+            *p++ = 'E';
+            p = putHex(p, entry, 6);
+            *p++ = '\n';
+            sinkCommit(s, p);
+            break;
+        }
+        case EMIT_BIN:
+            break;
+        case EMIT_IHEX: {
+            uint8_t start[4] = {(uint8_t)(entry >> 24), (uint8_t)(entry >> 16),
+                                (uint8_t)(entry >> 8), (uint8_t)entry};
+            ihexLine(s, 0, 0x05, start, sizeof(start));
+            ihexLine(s, 0, 0x01, NULL, 0);
+            break;
+        }
+        case EMIT_SREC:
+            srecLine(s, '8', entry, 3, NULL, 0);
+            break;
+        }
+
+        sinkFlush(s);
+        int failed;
+        if (s->compressor.fp) {
+            failed = compressClose(&s->compressor) != 0;
+        }
+        else {
+            failed = (s->fp == stdout) ? fflush(s->fp) != 0 : fclose(s->fp) != 0;
+        }
+        if (failed) {
+            fatalPath("Could not write emit output", s->path);
+        }
+    }
+    free(sinks);
+}
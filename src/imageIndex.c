@@ -0,0 +1,231 @@
+#include "imageIndex.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Implementation of the address index over a relocated program.
+ *
+ * This file implements:
+ *   - imageIndexBuild(): collects the non-empty T records and the M
+ *     records (moved by obj->relocFactor) and sorts both by address
+ *   - findText(): binary search for the last T record starting at or
+ *     before an address; the address is inside it when it is below the
+ *     record's end
+ *   - The byte, word and range reads, which copy from the record's bytes
+ *     when it was decoded and decode its hex text otherwise; a range
+ *     continues into the next record while the records touch
+ *   - imageFixupsAt(): binary search for the first fixup that can reach
+ *     the address (maxFieldBytes back), then a short forward scan
+ *   - printImageQuery(): one "byte/word/record" line and one line per
+ *     covering fixup
+ *
+ * Building is O(n log n); every query is O(log n) plus the size of its
+ * answer.
+ */
+
+#define IMAGE_NOT_FOUND ((size_t)-1)
+
+static int compareText(const void *a, const void *b) {
+    const textRecord *ta = *(const textRecord *const *)a;
+    const textRecord *tb = *(const textRecord *const *)b;
+
+    if (ta->address != tb->address) {
+        return (ta->address < tb->address) ? -1 : 1;
+    }
+    return 0;
+}
+
+// By field address, then by line so equal addresses keep file order
+static int compareFixup(const void *a, const void *b) {
+    const imageFixup *fa = (const imageFixup *)a;
+    const imageFixup *fb = (const imageFixup *)b;
+
+    if (fa->address != fb->address) {
+        return (fa->address < fb->address) ? -1 : 1;
+    }
+    if (fa->mod->line != fb->mod->line) {
+        return (fa->mod->line < fb->mod->line) ? -1 : 1;
+    }
+    return 0;
+}
+
+int imageIndexBuild(imageIndex *index, const objFile *obj) {
+    memset(index, 0, sizeof(*index));
+    index->obj = obj;
+    index->text = (const textRecord **)malloc((obj->textCount ? obj->textCount : 1) *
+                                              sizeof(*index->text));
+    index->fixups = (imageFixup *)malloc((obj->modCount ? obj->modCount : 1) *
+                                         sizeof(*index->fixups));
+    if (!index->text || !index->fixups) {
+        imageIndexFree(index);
+        return -1;
+    }
+
+    for (size_t i = 0; i < obj->textCount; i++) {
+        if (obj->textRecords[i].length > 0) {
+            index->text[index->textCount++] = &obj->textRecords[i];
+        }
+    }
+    qsort(index->text, index->textCount, sizeof(*index->text), compareText);
+
+    for (size_t i = 0; i < obj->modCount; i++) {
+        const modRecord *m = &obj->modRecords[i];
+        imageFixup *f = &index->fixups[index->fixupCount++];
+
+        f->address = m->address + (uint32_t)obj->relocFactor;
+        f->byteCount = (uint8_t)((m->lengthNibbles + 1) / 2);
+        f->mod = m;
+        if (f->byteCount > index->maxFieldBytes) {
+            index->maxFieldBytes = f->byteCount;
+        }
+    }
+    qsort(index->fixups, index->fixupCount, sizeof(*index->fixups), compareFixup);
+    return 0;
+}
+
+void imageIndexFree(imageIndex *index) {
+    free(index->text);
+    free(index->fixups);
+    index->text = NULL;
+    index->fixups = NULL;
+    index->textCount = 0;
+    index->fixupCount = 0;
+}
+
+// Position in index->text of the record holding address, or IMAGE_NOT_FOUND
+static size_t findText(const imageIndex *index, uint32_t address) {
+    size_t lo = 0, hi = index->textCount; // First record starting after address is in [lo, hi]
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (index->text[mid]->address <= address) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    if (lo == 0) {
+        return IMAGE_NOT_FOUND;
+    }
+    const textRecord *t = index->text[lo - 1];
+    return (address - t->address < t->length) ? lo - 1 : IMAGE_NOT_FOUND;
+}
+
+// Copy bytes [offset, offset + n) of a relocated T record
+static int copyText(const textRecord *t, uint32_t offset, uint8_t *out, size_t n) {
+    if (t->decoded) {
+        memcpy(out, t->bytes + offset, n);
+        return 0;
+    }
+    return objDecodeHex(t->hexText + (size_t)offset * 2U, n, out);
+}
+
+const textRecord *imageFindRecord(const imageIndex *index, uint32_t address) {
+    size_t i = findText(index, address);
+    return (i == IMAGE_NOT_FOUND) ? NULL : index->text[i];
+}
+
+int imageReadByte(const imageIndex *index, uint32_t address, uint8_t *out) {
+    size_t i = findText(index, address);
+
+    if (i == IMAGE_NOT_FOUND) {
+        return -1;
+    }
+    return copyText(index->text[i], address - index->text[i]->address, out, 1);
+}
+
+int imageReadWord(const imageIndex *index, uint32_t address, uint32_t *out) {
+    uint8_t bytes[IMAGE_WORD_BYTES];
+
+    if (imageReadRange(index, address, bytes, sizeof(bytes)) != sizeof(bytes)) {
+        return -1;
+    }
+    *out = ((uint32_t)bytes[0] << 16) | ((uint32_t)bytes[1] << 8) | bytes[2];
+    return 0;
+}
+
+size_t imageReadRange(const imageIndex *index, uint32_t address, uint8_t *out, size_t length) {
+    size_t i = findText(index, address);
+    size_t done = 0;
+
+    while (i != IMAGE_NOT_FOUND && done < length) {
+        const textRecord *t = index->text[i];
+        uint32_t offset = address - t->address;
+        size_t n = t->length - offset;
+
+        if (n > length - done) {
+            n = length - done;
+        }
+        if (copyText(t, offset, out + done, n) != 0) {
+            break;
+        }
+        done += n;
+        address += (uint32_t)n;
+
+        // Continue only into a record that starts right where this one ends
+        i = (i + 1 < index->textCount && index->text[i + 1]->address == address)
+            ? i + 1 : IMAGE_NOT_FOUND;
+    }
+    return done;
+}
+
+size_t imageFixupsAt(const imageIndex *index, uint32_t address, const imageFixup **first) {
+    uint32_t from = (address >= index->maxFieldBytes) ? address - index->maxFieldBytes + 1U : 0U;
+    size_t lo = 0, hi = index->fixupCount;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (index->fixups[mid].address < from) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+
+    // Fixups [lo, end) start close enough to reach address; the caller
+    // checks each with address - f->address < f->byteCount
+    size_t end = lo;
+    while (end < index->fixupCount && index->fixups[end].address <= address) {
+        end++;
+    }
+    *first = index->fixups + lo;
+    return end - lo;
+}
+
+void printImageQuery(const imageIndex *index, uint32_t address, FILE *out) {
+    size_t i = findText(index, address);
+
+    if (i == IMAGE_NOT_FOUND) {
+        fprintf(out, "%06X not loaded\n", (unsigned int)address);
+        return;
+    }
+
+    const textRecord *t = index->text[i];
+    uint8_t byte = 0;
+    uint32_t word = 0;
+    copyText(t, address - t->address, &byte, 1);
+    fprintf(out, "%06X byte %02X ", (unsigned int)address, (unsigned int)byte);
+    if (imageReadWord(index, address, &word) == 0) {
+        fprintf(out, "word %06X", (unsigned int)word);
+    }
+    else {
+        fprintf(out, "word ------");
+    }
+    fprintf(out, " in T record line %u (%06X, %u bytes)\n", (unsigned int)t->line,
+            (unsigned int)t->address, (unsigned int)t->length);
+
+    const imageFixup *f;
+    size_t count = imageFixupsAt(index, address, &f);
+    for (size_t k = 0; k < count; k++) {
+        if (address - f[k].address < f[k].byteCount) {
+            fprintf(out, "%06X fixup M record line %u (field %06X, %u nibbles, %c)\n",
+                    (unsigned int)address, (unsigned int)f[k].mod->line,
+                    (unsigned int)f[k].address, (unsigned int)f[k].mod->lengthNibbles,
+                    f[k].mod->sign);
+        }
+    }
+}
@@ -1,7 +1,12 @@
+#include "audit.h"
+#include "emit.h"
+#include "imageIndex.h"
 #include "loader.h"
+#include "memory.h"
 #include "objFile.h"
 #include "relocSic.h"
 #include "relocSicXE.h"
+#include "trace.h"
 #include "util.h"
 #include <stdio.h>
 
@@ -10,46 +15,187 @@
  *
  * This file implements:
  *   - Implement runLoader(), the main function exposed by loader.h
- *   - Call objParseFile() to read the input object file into a objFile
- *   - Based on the MachineType (SIC or SICXE), call the appropriate
- *     relocation backend (relocateSic() or relocateSicXE())
+ *   - Call objParseFileParallel() to read the input object file into a
+ *     objFile (large files are parsed on config->jobs threads)
+ *   - Clear the part of the simulated memory the program is loaded into
+ *     and, based on the MachineType (SIC or SICXE), call the appropriate
+ *     relocation backend (relocateObject() picks relocateSic() or
+ *     relocateSicXE())
+ *   - With config->audit, check the SIC/XE code against its M records
+ *     first (auditSicXE()); findings are warnings on stderr
  *   - After relocation, emit the relocated T (Text) and E (End) records
- *     to stdout in the expected object file format
+ *     to stdout in the expected object file format. Records that were
+ *     never decoded are written by copying their original hex text.
+ *     printRelocatedRecords() formats everything into one buffer and
+ *     hands it to the output stream with a single fwrite(), and takes
+ *     the stream so other modes can write elsewhere.
+ *   - With config->emitTargets, write the relocated program to every
+ *     --emit target instead (emitRecords(), one pass for all formats)
+ *   - With config->queries, index the relocated program (imageIndexBuild())
+ *     and print what lives at each queried address instead of the records
+ *   - In OUTPUT_DELTA mode, compare each relocated record against its
+ *     original payload and emit only the changed bytes as minimal T records
  *   - Clean up any allocated resources (via objFree())
  *
  * This module is in charge of calling the other functions of the loader.
  */
 
-static void printRelocatedRecords(const objFile *obj){
+void relocateObject(objFile *obj, uint32_t reloc, machineType machine) {
+    if (machine == MACHINE_SIC) {
+        relocateSic(obj, reloc);
+    } else {
+        relocateSicXE(obj, reloc);
+    }
+}
+
+static const char hexDigits[] = "0123456789ABCDEF";
+
+// Write value as 'digits' uppercase hex digits at p
+static char *putHex(char *p, uint32_t value, int digits){
+    for(int i = digits - 1; i >= 0; i--){
+        p[i] = hexDigits[value & 0xFU];
+        value >>= 4;
+    }
+    return p + digits;
+}
+
+void printRelocatedRecords(const objFile *obj, FILE *out){
+    // Exact output size: "T" + address + length + payload + newline per record, then "E" + address + newline
+    size_t size = 8;
+    for(size_t i = 0; i < obj->textCount; i++){
+        size += 10 + (size_t)obj->textRecords[i].length * 2U;
+    }
+
+    char stackBuffer[4096];
+    char *buffer = (size <= sizeof(stackBuffer)) ? stackBuffer : (char *)malloc(size);
+    if(!buffer){
+        fatal("Out of memory.");
+    }
+
+    char *p = buffer;
+    for(size_t i = 0; i < obj->textCount; i++){
+        const textRecord *t = &obj->textRecords[i];
+
+        // Text record header
+        *p++ = 'T';
+        p = putHex(p, t->address, 6);
+        p = putHex(p, t->length, 2);
+        if(!t->decoded){
+            // Untouched record: copy the original hex payload verbatim
+            memcpy(p, t->hexText, (size_t)t->length * 2U);
+            p += (size_t)t->length * 2U;
+        }
+        else{
+            for(size_t j = 0; j < t->length; j++){
+                *p++ = hexDigits[t->bytes[j] >> 4];
+                *p++ = hexDigits[t->bytes[j] & 0xFU];
+            }//Iterate through the object code bytes
+        }
+        *p++ = '\n';
+    }//Iterate through the Text records
+
+    // End record
+    *p++ = 'E';
+    p = putHex(p, obj->endRecord.firstExecAddress, 6);
+    *p++ = '\n';
+
+    fwrite(buffer, 1, (size_t)(p - buffer), out);
+    if(buffer != stackBuffer){
+        free(buffer);
+    }
+}
+
+// Print one T record holding bytes[start, end) of a relocated text record
+static void printDeltaRun(const textRecord *t, uint32_t start, uint32_t end, FILE *out){
+    fprintf(out, "T%06X%02X", ((unsigned int)(t->address + start)), ((unsigned int)(end - start)));
+    for(uint32_t j = start; j < end; j++){
+        fprintf(out, "%02X", ((unsigned int)t->bytes[j]));
+    }
+    fprintf(out, "\n");
+}
+
+void printDeltaRecords(const objFile *obj, FILE *out){
     for(size_t i = 0; i < obj->textCount; i++){
         const textRecord *t = &obj->textRecords[i];
+        uint8_t original[MAX_T_BYTES];
+
+        // Records that were never decoded can not have changed
+        if(!t->decoded){
+            continue;
+        }
+        if(objDecodeHex(t->hexText, t->length, original) != 0){
+            fatal("Failed to decode original text record.");
+        }
 
-        // Print Text record header
-        printf("T%06X%02X", ((unsigned int)t->address), ((unsigned int)t->length));
-        for(size_t j = 0; j < t->length; j++){
-            printf("%02X", ((unsigned int)t->bytes[j]));
-        }//Iterate through the object code bytes
-        printf("\n");
+        // Emit every run of consecutive changed bytes as its own T record
+        uint32_t j = 0;
+        while(j < t->length){
+            if(t->bytes[j] == original[j]){
+                j++;
+                continue;
+            }
+            uint32_t start = j;
+            while(j < t->length && t->bytes[j] != original[j]){
+                j++;
+            }
+            printDeltaRun(t, start, j, out);
+        }
     }//Iterate through the Text records
 
     // Print End record
-    printf("E%06X\n", (unsigned int)obj->endRecord.firstExecAddress);
+    fprintf(out, "E%06X\n", (unsigned int)obj->endRecord.firstExecAddress);
 }
 
 int runLoader(const LoaderConfig *config) {
     objFile obj = {0};
 
-    if (objParseFile(config->filePath, &obj) != 0) {
+    if (objParseFileParallel(config->filePath, &obj, config->jobs) != 0) {
+        if (objParseMessage()) {
+            printf("Error: %s\n", objParseMessage());
+        }
         fatal("Failed to parse SCOFF file.");
     }
 
-    if (config->machineType == MACHINE_SIC) {
-        relocateSic(&obj, config->relocationAddress);
-    } else {
-        relocateSicXE(&obj, config->relocationAddress);
+    if (config->audit && config->machineType == MACHINE_SICXE &&
+        auditSicXE(&obj, stderr) < 0) {
+        fatal("Failed to audit SCOFF file.");
+    }
+
+    // The relocators only read back bytes they loaded themselves, so
+    // clearing the program's own range is enough (no full memInit())
+    uint32_t clearEnd = config->relocationAddress + obj.header.programLength;
+    if (config->relocationAddress < MEM_SIZE) {
+        if (clearEnd > MEM_SIZE || clearEnd < config->relocationAddress) {
+            clearEnd = MEM_SIZE;
+        }
+        memFill(config->relocationAddress, 0, clearEnd - config->relocationAddress);
     }
+    relocateObject(&obj, config->relocationAddress, config->machineType);
     
-    printRelocatedRecords(&obj);
+    uint64_t spanStart = traceNow();
+    if (config->queryCount > 0) {
+        imageIndex index;
+        if (imageIndexBuild(&index, &obj) != 0) {
+            fatal("Out of memory.");
+        }
+        for (size_t i = 0; i < config->queryCount; i++) {
+            printImageQuery(&index, config->queries[i], stdout);
+        }
+        imageIndexFree(&index);
+    } else if (config->emitCount > 0) {
+        emitRecords(&obj, config->emitTargets, config->emitCount);
+    } else if (config->outputMode == OUTPUT_DELTA) {
+        printDeltaRecords(&obj, stdout);
+    } else {
+        printRelocatedRecords(&obj, stdout);
+    }
+    if (traceEnabled()) {
+        uint64_t bytes = 0;
+        for (size_t i = 0; i < obj.textCount; i++) {
+            bytes += obj.textRecords[i].length;
+        }
+        traceSpan("emit", config->filePath, spanStart, bytes, obj.textCount + 1);
+    }
     objFree(&obj);
     return 0;
 }
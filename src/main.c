@@ -1,43 +1,474 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include "archive.h"
+#include "check.h"
 #include "loader.h"
+#include "meta.h"
+#include "parallel.h"
+#include "placement.h"
+#include "stream.h"
+#include "trace.h"
 #include "util.h"
+#include "verify.h"
+#include "watch.h"
 
 /**
  * Entry point for the SIC / SICXE relocating loader.
  *
  * This file implements:
  *   - Parse and validate command-line arguments:
- *       <objectFile> <relocAddressHex> <SIC|SICXE>
+ *       [--delta] [--audit] [--emit=<fmt>:<path>]... [--query=ADDR[,ADDR...]] [--jobs=N] [--trace=<file>] <objectFile> <relocAddressHex> <SIC|SICXE>
+ *       --check [--jobs=N] <objectFile|@listFile>...
+ *       --meta[=csv|json] [--jobs=N] <objectFile|directory>...
+ *       --ar-create|--ar-append <archive> <objectFile>...
+ *       --ar-list <archive>
+ *       --archive=<archive> [--member=<name>] [--delta] <relocAddressHex> <SIC|SICXE>
+ *       --place [--align=HEX] [--map=<file>] <SIC|SICXE> <objectFile>...
+ *       --watch [--out=<dir>] <directory> <relocConfig>
+ *       --verify <objectFile>...
+ *       --fuzz=<count>[,<seed>]
+ *       --stream [--stride=HEX] [--relocs=<file>] [--delta] <objectFile|-> <relocAddressHex> <SIC|SICXE>
+ *   - Collect the repeatable --emit=<scoff|bin|ihex|srec>:<path> options
+ *     into the LoaderConfig (emitParseTarget())
+ *   - Collect the --query=<hex>[,<hex>...] addresses to look up in the
+ *     relocated program
  *   - Convert the relocation address from a hex string to an integer
  *   - Map the machine type string to the MachineType enum
- *   - Populate a LoaderConfig and call runLoader()
+ *   - Populate a LoaderConfig and call runLoader(), or hand the file
+ *     list to runCheck() in --check mode, runMeta() in --meta mode or
+ *     runPlacement() in --place mode,
+ *     fill a streamConfig for runStream() in --stream mode, or call
+ *     runWatch() in --watch mode and runVerify() / runFuzz() in the
+ *     --verify / --fuzz self-test modes
+ *   - Hand archive commands to archive.c: archiveWrite(), archiveList()
+ *     and runArchiveLoad() for --archive
  *
  * This file processes the console input into the loader defined in loader.h.
  */
 
+// Program modes selected on the command line
+typedef enum {
+    MODE_LOAD = 0, // Relocate one object file (default)
+    MODE_CHECK = 1, // Validate a list of object files
+    MODE_PLACE = 2, // Place and relocate several programs into one image
+    MODE_STREAM = 3, // Relocate a stream of concatenated programs
+    MODE_WATCH = 4, // Keep the outputs of a directory of objects up to date
+    MODE_VERIFY = 5, // Compare against the reference loader on object files
+    MODE_FUZZ = 6, // Compare against the reference loader on generated programs
+    MODE_META = 7, // Print H/E metadata of many object files
+    MODE_AR_CREATE = 8, // Build an object archive
+    MODE_AR_APPEND = 9, // Add object files to an archive
+    MODE_AR_LIST = 10 // Print the index of an archive
+} programMode;
+
+// Options that only some modes take, as bits of a "given" mask
+enum {
+    OPT_DELTA = 1 << 0,
+    OPT_AUDIT = 1 << 1,
+    OPT_EMIT = 1 << 2,
+    OPT_QUERY = 1 << 3,
+    OPT_JOBS = 1 << 4,
+    OPT_STRIDE = 1 << 5,
+    OPT_RELOCS = 1 << 6,
+    OPT_ALIGN = 1 << 7,
+    OPT_MAP = 1 << 8,
+    OPT_OUT = 1 << 9
+};
+
+// Spelling of each OPT_ bit, in bit order
+static const char *const optionNames[] = {
+    "--delta", "--audit", "--emit", "--query", "--jobs",
+    "--stride", "--relocs", "--align", "--map", "--out"
+};
+
+// Growable list of file paths
+typedef struct {
+    const char **items;
+    size_t count;
+    size_t capacity;
+} pathList;
+
+static void usage(const char *prog) {
+    printf("ERROR: Usage: %s [--delta] [--audit] [--emit=<scoff|bin|ihex|srec>:<path>]... [--query=HEX[,HEX...]] [--jobs=N] [--trace=<file>] <objectFile> <relocAddressHex> <SIC|SICXE>\n", prog);
+    printf("       %s --check [--jobs=N] [--trace=<file>] <objectFile|@listFile>...\n", prog);
+    printf("       %s --meta[=csv|json] [--jobs=N] <objectFile|directory>...\n", prog);
+    printf("       %s --ar-create|--ar-append <archive> <objectFile>...\n", prog);
+    printf("       %s --ar-list <archive>\n", prog);
+    printf("       %s --archive=<archive> [--member=<name>] [--delta] <relocAddressHex> <SIC|SICXE>\n", prog);
+    printf("       %s --place [--align=HEX] [--map=<file>] <SIC|SICXE> <objectFile>...\n", prog);
+    printf("       %s --watch [--out=<dir>] <directory> <relocConfig>\n", prog);
+    printf("       %s --verify <objectFile>...\n", prog);
+    printf("       %s --fuzz=<count>[,<seed>]\n", prog);
+    printf("       %s --stream [--stride=HEX] [--relocs=<file>] [--delta] <objectFile|-> <relocAddressHex> <SIC|SICXE>\n", prog);
+}
+
+static void pathListAdd(pathList *list, const char *path) {
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 16;
+        const char **temp = (const char **)realloc(list->items, capacity * sizeof(*temp));
+        if (!temp) {
+            fatal("Out of memory.");
+        }
+        list->items = temp;
+        list->capacity = capacity;
+    }
+    list->items[list->count++] = path;
+}
+
+// Add every non-empty line of listPath to list
+static void pathListRead(pathList *list, const char *listPath) {
+    FILE *fp = fopen(listPath, "r");
+    char line[4096];
+
+    if (!fp) {
+        fatal("Could not open file list.");
+    }
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        size_t len = strcspn(line, "\r\n");
+        line[len] = '\0';
+        if (len == 0) {
+            continue;
+        }
+        char *path = (char *)malloc(len + 1);
+        if (!path) {
+            fatal("Out of memory.");
+        }
+        memcpy(path, line, len + 1);
+        pathListAdd(list, path);
+    }
+    fclose(fp);
+}
+
+// Stop on the first option in given that modeName does not take
+static void rejectOptions(const char *modeName, unsigned int given, unsigned int allowed) {
+    unsigned int extra = given & ~allowed;
+
+    for (size_t b = 0; b < sizeof(optionNames) / sizeof(optionNames[0]); b++) {
+        if (extra & (1U << b)) {
+            static char msg[96];
+            snprintf(msg, sizeof(msg), "%s can not be combined with %s.", optionNames[b], modeName);
+            fatal(msg);
+        }
+    }
+}
+
+// Map "SIC" / "SICXE" to the machineType enum
+static machineType parseMachine(const char *s) {
+    if (strcmp(s, "SIC") == 0) {
+        return MACHINE_SIC;
+    }
+    if (strcmp(s, "SICXE") != 0) {
+        fatal("Invalid machine type. Use SIC or SICXE.");
+    }
+    return MACHINE_SICXE;
+}
 
 int main(int argc, char *argv[]) {
-    if (argc != 4) {
-        printf("ERROR: Usage: %s <objectFile> <relocAddressHex> <SIC|SICXE>\n", argv[0]);
+    LoaderConfig config;
+    programMode mode = MODE_LOAD;
+    unsigned int jobs = 0; // 0 = one per online processor
+    uint32_t align = 1; // Placement alignment in bytes
+    const char *mapPath = NULL; // Load map destination (stderr when NULL)
+    uint32_t stride = 0; // Stream mode: address step between programs (0 packs them)
+    const char *relocsPath = NULL; // Stream mode: per-program relocation addresses
+    const char *outDir = NULL; // Watch mode: output directory
+    unsigned long fuzzCount = 0, fuzzSeed = 1; // Fuzz mode: cases and generator seed
+    metaFormat format = META_CSV; // Meta mode: table format
+    const char *archivePath = NULL; // Load from this archive instead of a file
+    const char *member = NULL; // Archive member to load (all when NULL)
+    emitTarget *emits = NULL; // --emit outputs, in command-line order
+    size_t emitCount = 0;
+    uint32_t *queries = NULL; // --query addresses, in command-line order
+    size_t queryCount = 0;
+    pathList args = {0}; // Positional arguments
+    unsigned int given = 0; // OPT_ bits seen on the command line
+
+    memset(&config, 0, sizeof(config));
+    config.outputMode = OUTPUT_FULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--delta") == 0) {
+            config.outputMode = OUTPUT_DELTA;
+            given |= OPT_DELTA;
+        }
+        else if (strcmp(argv[i], "--audit") == 0) {
+            config.audit = 1;
+            given |= OPT_AUDIT;
+        }
+        else if (strncmp(argv[i], "--emit=", 7) == 0) {
+            emitTarget *temp = (emitTarget *)realloc(emits, (emitCount + 1) * sizeof(*temp));
+            if (!temp) {
+                fatal("Out of memory.");
+            }
+            emits = temp;
+            if (emitParseTarget(argv[i] + 7, &emits[emitCount]) != 0) {
+                fatal("Invalid emit target. Use --emit=<scoff|bin|ihex|srec>:<path>.");
+            }
+            emitCount++;
+            given |= OPT_EMIT;
+        }
+        else if (strncmp(argv[i], "--query=", 8) == 0) {
+            char *list = argv[i] + 8;
+            for (char *item = strtok(list, ","); item; item = strtok(NULL, ",")) {
+                uint32_t *temp = (uint32_t *)realloc(queries, (queryCount + 1) * sizeof(*temp));
+                if (!temp) {
+                    fatal("Out of memory.");
+                }
+                queries = temp;
+                if (!parseHex(item, &queries[queryCount])) {
+                    fatal("Invalid hex query address.");
+                }
+                queryCount++;
+            }
+            if (queryCount == 0) {
+                fatal("Invalid hex query address.");
+            }
+            given |= OPT_QUERY;
+        }
+        else if (strcmp(argv[i], "--check") == 0) {
+            mode = MODE_CHECK;
+        }
+        else if (strcmp(argv[i], "--meta") == 0 || strcmp(argv[i], "--meta=csv") == 0) {
+            mode = MODE_META;
+            format = META_CSV;
+        }
+        else if (strcmp(argv[i], "--meta=json") == 0) {
+            mode = MODE_META;
+            format = META_JSON;
+        }
+        else if (strcmp(argv[i], "--ar-create") == 0) {
+            mode = MODE_AR_CREATE;
+        }
+        else if (strcmp(argv[i], "--ar-append") == 0) {
+            mode = MODE_AR_APPEND;
+        }
+        else if (strcmp(argv[i], "--ar-list") == 0) {
+            mode = MODE_AR_LIST;
+        }
+        else if (strncmp(argv[i], "--archive=", 10) == 0) {
+            archivePath = argv[i] + 10;
+        }
+        else if (strncmp(argv[i], "--member=", 9) == 0) {
+            member = argv[i] + 9;
+        }
+        else if (strcmp(argv[i], "--place") == 0) {
+            mode = MODE_PLACE;
+        }
+        else if (strcmp(argv[i], "--watch") == 0) {
+            mode = MODE_WATCH;
+        }
+        else if (strncmp(argv[i], "--out=", 6) == 0) {
+            outDir = argv[i] + 6;
+            given |= OPT_OUT;
+        }
+        else if (strcmp(argv[i], "--verify") == 0) {
+            mode = MODE_VERIFY;
+        }
+        else if (strncmp(argv[i], "--fuzz=", 7) == 0) {
+            char *end;
+            fuzzCount = strtoul(argv[i] + 7, &end, 10);
+            if (*end == ',') {
+                fuzzSeed = strtoul(end + 1, &end, 10);
+            }
+            if (*end != '\0' || fuzzCount == 0) {
+                fatal("Invalid fuzz case count or seed.");
+            }
+            mode = MODE_FUZZ;
+        }
+        else if (strcmp(argv[i], "--stream") == 0) {
+            mode = MODE_STREAM;
+        }
+        else if (strncmp(argv[i], "--stride=", 9) == 0) {
+            if (!parseHex(argv[i] + 9, &stride) || stride == 0) {
+                fatal("Invalid hex stride.");
+            }
+            given |= OPT_STRIDE;
+        }
+        else if (strncmp(argv[i], "--relocs=", 9) == 0) {
+            relocsPath = argv[i] + 9;
+            given |= OPT_RELOCS;
+        }
+        else if (strncmp(argv[i], "--align=", 8) == 0) {
+            if (!parseHex(argv[i] + 8, &align) || align == 0) {
+                fatal("Invalid hex alignment.");
+            }
+            given |= OPT_ALIGN;
+        }
+        else if (strncmp(argv[i], "--map=", 6) == 0) {
+            mapPath = argv[i] + 6;
+            given |= OPT_MAP;
+        }
+        else if (strncmp(argv[i], "--jobs=", 7) == 0) {
+            char *end;
+            unsigned long n = strtoul(argv[i] + 7, &end, 10);
+            if (*end != '\0' || n == 0 || n > 1024) {
+                fatal("Invalid job count.");
+            }
+            jobs = (unsigned int)n;
+            given |= OPT_JOBS;
+        }
+        else if (strncmp(argv[i], "--trace=", 8) == 0) {
+            if (traceOpen(argv[i] + 8) != 0) {
+                fatal("Invalid trace output file.");
+            }
+        }
+        else if (strncmp(argv[i], "--", 2) == 0) {
+            usage(argv[0]);
+            return 1;
+        }
+        else {
+            pathListAdd(&args, argv[i]);
+        }
+    }
+
+    if (jobs == 0) {
+        jobs = defaultJobCount();
+    }
+
+    if (member && !archivePath) {
+        fatal("--member picks a program from an archive; it needs --archive.");
+    }
+
+    if (mode == MODE_CHECK) {
+        rejectOptions("--check", given, OPT_JOBS);
+        pathList files = {0};
+        for (size_t i = 0; i < args.count; i++) {
+            if (args.items[i][0] == '@') {
+                pathListRead(&files, args.items[i] + 1);
+            }
+            else {
+                pathListAdd(&files, args.items[i]);
+            }
+        }
+        if (files.count == 0) {
+            usage(argv[0]);
+            return 1;
+        }
+        return runCheck(files.items, files.count, jobs);
+    }
+
+    if (mode == MODE_META) {
+        rejectOptions("--meta", given, OPT_JOBS);
+        if (args.count == 0) {
+            usage(argv[0]);
+            return 1;
+        }
+        return runMeta(args.items, args.count, format, jobs);
+    }
+
+    if (mode == MODE_AR_CREATE || mode == MODE_AR_APPEND) {
+        rejectOptions(mode == MODE_AR_CREATE ? "--ar-create" : "--ar-append", given, 0);
+        if (args.count < 2) {
+            usage(argv[0]);
+            return 1;
+        }
+        return archiveWrite(args.items[0], args.items + 1, args.count - 1,
+                            mode == MODE_AR_APPEND);
+    }
+
+    if (mode == MODE_AR_LIST) {
+        rejectOptions("--ar-list", given, 0);
+        if (args.count != 1) {
+            usage(argv[0]);
+            return 1;
+        }
+        return archiveList(args.items[0]);
+    }
+
+    if (archivePath) {
+        if (mode != MODE_LOAD || args.count != 2) {
+            usage(argv[0]);
+            return 1;
+        }
+        rejectOptions("--archive", given, OPT_DELTA);
+        uint32_t reloc;
+        if (!parseHex(args.items[0], &reloc)) {
+            fatal("Invalid hex relocation address.");
+        }
+        return runArchiveLoad(archivePath, member, reloc, parseMachine(args.items[1]),
+                              config.outputMode);
+    }
+
+    if (mode == MODE_PLACE) {
+        rejectOptions("--place", given, OPT_ALIGN | OPT_MAP);
+        if (args.count < 2) {
+            usage(argv[0]);
+            return 1;
+        }
+        return runPlacement(args.items + 1, args.count - 1, parseMachine(args.items[0]),
+                            align, mapPath);
+    }
+
+    if (mode == MODE_VERIFY) {
+        rejectOptions("--verify", given, 0);
+        if (args.count == 0) {
+            usage(argv[0]);
+            return 1;
+        }
+        return runVerify(args.items, args.count);
+    }
+
+    if (mode == MODE_FUZZ) {
+        rejectOptions("--fuzz", given, 0);
+        if (args.count != 0) {
+            usage(argv[0]);
+            return 1;
+        }
+        return runFuzz(fuzzCount, fuzzSeed);
+    }
+
+    if (mode == MODE_WATCH) {
+        rejectOptions("--watch", given, OPT_OUT);
+        if (args.count != 2) {
+            usage(argv[0]);
+            return 1;
+        }
+        return runWatch(args.items[0], args.items[1], outDir);
+    }
+
+    if (mode == MODE_STREAM) {
+        rejectOptions("--stream", given, OPT_DELTA | OPT_STRIDE | OPT_RELOCS);
+    }
+    else {
+        rejectOptions("a plain load", given, OPT_DELTA | OPT_AUDIT | OPT_EMIT | OPT_QUERY | OPT_JOBS);
+    }
+    if (args.count != 3) {
+        usage(argv[0]);
         return 1;
     }
 
-    LoaderConfig config;
-    config.filePath = argv[1];
+    config.filePath = args.items[0];
+    config.jobs = jobs;
+    config.emitTargets = emits;
+    config.emitCount = emitCount;
+    config.queries = queries;
+    config.queryCount = queryCount;
+    if (emitCount > 0 && config.outputMode == OUTPUT_DELTA) {
+        fatal("--emit writes full images of one object file; it can not be combined with --delta.");
+    }
+    if (queryCount > 0 && (config.outputMode == OUTPUT_DELTA || emitCount > 0)) {
+        fatal("--query answers lookups instead of printing records; it can not be combined with --delta or --emit.");
+    }
 
-    if (!parseHex (argv[2], &config.relocationAddress)) {
+    if (!parseHex (args.items[1], &config.relocationAddress)) {
         fatal("Invalid hex relocation address.");
     }
 
-    if (strcmp(argv[3], "SIC") == 0) {
-        config.machineType = MACHINE_SIC;
-    } 
-    else if (strcmp(argv[3], "SICXE") == 0) {
-        config.machineType = MACHINE_SICXE;
-    } 
-    else {
-        fatal("Invalid machine type. Use SIC or SICXE.");
+    config.machineType = parseMachine(args.items[2]);
+    if (config.audit && config.machineType != MACHINE_SICXE) {
+        fatal("--audit checks SIC/XE code; use it with SICXE.");
+    }
+
+    if (mode == MODE_STREAM) {
+        streamConfig stream;
+        stream.inputPath = config.filePath;
+        stream.baseAddress = config.relocationAddress;
+        stream.stride = stride;
+        stream.relocsPath = relocsPath;
+        stream.machineType = config.machineType;
+        stream.outputMode = config.outputMode;
+        return runStream(&stream);
     }
 
     return runLoader(&config);
@@ -1,6 +1,8 @@
 #include "memory.h"
 #include "util.h"
 
+#include <string.h>
+
 /** 
  * Simple simulated memory implementation for the relocating loader.
  *
@@ -9,6 +11,11 @@
  *   - Implement memInit() to clear memory
  *   - Implement memWriteByte() / memReadByte() with bounds checking
  *   - Implement memWriteWord() / memReadWord() for 3-byte SIC words
+ *   - Implement the block operations memWriteBlock(), memReadBlock(),
+ *     memFill() and memCompare(), which range-check the span once and
+ *     then use memcpy/memset/memcmp
+ *   - Implement memWriteField() / memReadField() for big-endian fields
+ *     of 1 to 4 bytes
  *
  * Optional design:
  *   - The loader and relocation modules may choose to load all text
@@ -20,12 +27,17 @@
 
 static uint8_t memory[MEM_SIZE];
 
-void memInit(void) {
-    for (uint32_t i = 0; i < MEM_SIZE; i++) {
-        memory[i] = 0;
+// Fail unless [addr, addr + len) lies inside memory
+static void checkRange(uint32_t addr, uint32_t len, const char *msg) {
+    if (len > MEM_SIZE || addr > MEM_SIZE - len) {
+        fatal(msg);
     }
 }
 
+void memInit(void) {
+    memset(memory, 0, sizeof(memory));
+}
+
 void memWriteByte(uint32_t addr, uint8_t value) {
     if (addr >= MEM_SIZE) {
         fatal("Memory write out of range");
@@ -42,14 +54,67 @@ uint8_t memReadByte(uint32_t addr) {
 
 void memWriteWord(uint32_t addr, uint32_t value) {
     // SIC word = 3 bytes
-    memWriteByte(addr,     (value >> 16) & 0xFF);
-    memWriteByte(addr + 1, (value >> 8)  & 0xFF);
-    memWriteByte(addr + 2,  value        & 0xFF);
+    memWriteField(addr, value, 3);
 }
 
 uint32_t memReadWord(uint32_t addr) {
-    uint32_t b1 = memReadByte(addr);
-    uint32_t b2 = memReadByte(addr + 1);
-    uint32_t b3 = memReadByte(addr + 2);
-    return (b1 << 16) | (b2 << 8) | b3;
+    return memReadField(addr, 3);
+}
+
+void memWriteBlock(uint32_t addr, const uint8_t *src, uint32_t len) {
+    if (len == 0) {
+        return;
+    }
+    checkRange(addr, len, "Memory write out of range");
+    memcpy(&memory[addr], src, len);
+}
+
+void memReadBlock(uint32_t addr, uint8_t *dst, uint32_t len) {
+    if (len == 0) {
+        return;
+    }
+    checkRange(addr, len, "Memory read out of range");
+    memcpy(dst, &memory[addr], len);
+}
+
+void memFill(uint32_t addr, uint8_t value, uint32_t len) {
+    if (len == 0) {
+        return;
+    }
+    checkRange(addr, len, "Memory write out of range");
+    memset(&memory[addr], value, len);
+}
+
+int memCompare(uint32_t addr, const uint8_t *src, uint32_t len) {
+    if (len == 0) {
+        return 0;
+    }
+    checkRange(addr, len, "Memory read out of range");
+    return memcmp(&memory[addr], src, len);
+}
+
+void memWriteField(uint32_t addr, uint32_t value, uint8_t width) {
+    if (width == 0 || width > 4) {
+        fatal("Memory field width must be 1 to 4 bytes");
+    }
+    checkRange(addr, width, "Memory write out of range");
+
+    // Most significant byte first
+    for (int b = (int)width - 1; b >= 0; --b) {
+        memory[addr + (uint32_t)b] = (uint8_t)(value & 0xFFU);
+        value >>= 8;
+    }
+}
+
+uint32_t memReadField(uint32_t addr, uint8_t width) {
+    if (width == 0 || width > 4) {
+        fatal("Memory field width must be 1 to 4 bytes");
+    }
+    checkRange(addr, width, "Memory read out of range");
+
+    uint32_t value = 0;
+    for (uint8_t b = 0; b < width; ++b) {
+        value = (value << 8) | memory[addr + b];
+    }
+    return value;
 }
@@ -0,0 +1,217 @@
+#include "meta.h"
+#include "objFile.h"
+#include "parallel.h"
+#include "util.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+/**
+ * Implementation of the --meta inventory mode.
+ *
+ * This file implements:
+ *   - collectFiles(), which turns the command-line paths into a list of
+ *     regular files, walking directories recursively with scandir()
+ *   - runMeta(), which scans every file with objScanMetadata() on a pool
+ *     of worker threads, storing one result per file, and then prints the
+ *     table in list order so the output is deterministic
+ *   - CSV and JSON writers with the quoting each format needs
+ *
+ * Only the first and last records of each file are read, so the cost per
+ * file is an open and two small reads no matter how large the program is.
+ */
+
+// Growable list of file paths (owned)
+typedef struct {
+    char **items;
+    size_t count;
+    size_t capacity;
+} fileList;
+
+typedef struct {
+    char *const *paths; // Files to scan
+    objMetadata *results; // One per path
+    int *status; // 0 = scanned, -1 = failed, one per path
+} metaJob;
+
+static void fileListAdd(fileList *list, char *path) {
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 256;
+        char **temp = (char **)realloc(list->items, capacity * sizeof(*temp));
+        if (!temp) {
+            fatal("Out of memory.");
+        }
+        list->items = temp;
+        list->capacity = capacity;
+    }
+    list->items[list->count++] = path;
+}
+
+static char *copyPath(const char *dir, const char *name) {
+    size_t n = strlen(dir) + (name ? strlen(name) + 1 : 0) + 1;
+    char *path = (char *)malloc(n);
+    if (!path) {
+        fatal("Out of memory.");
+    }
+    if (name) {
+        snprintf(path, n, "%s/%s", dir, name);
+    }
+    else {
+        memcpy(path, dir, n);
+    }
+    return path;
+}
+
+static int skipHidden(const struct dirent *entry) {
+    return entry->d_name[0] != '.';
+}
+
+// Add path to list, or every file below it when it is a directory
+static void collectFiles(fileList *list, const char *path) {
+    struct stat st;
+
+    if (stat(path, &st) != 0 || !S_ISDIR(st.st_mode)) {
+        fileListAdd(list, copyPath(path, NULL)); // Missing files show up as failed rows
+        return;
+    }
+
+    struct dirent **entries;
+    int n = scandir(path, &entries, skipHidden, alphasort);
+    if (n < 0) {
+        fileListAdd(list, copyPath(path, NULL));
+        return;
+    }
+    for (int i = 0; i < n; i++) {
+        char *child = copyPath(path, entries[i]->d_name);
+        if (stat(child, &st) != 0) {
+            fileListAdd(list, child); // e.g. a dangling link: reported as a failed row
+        }
+        else if (S_ISDIR(st.st_mode)) {
+            collectFiles(list, child);
+            free(child);
+        }
+        else if (S_ISREG(st.st_mode)) {
+            fileListAdd(list, child);
+        }
+        else {
+            free(child);
+        }
+        free(entries[i]);
+    }
+    free(entries);
+}
+
+static void scanOne(size_t index, void *ctx) {
+    metaJob *job = (metaJob *)ctx;
+    job->status[index] = objScanMetadata(job->paths[index], &job->results[index]);
+}
+
+// Write s as a CSV field, quoted when it holds a separator or a quote
+static void printCsvField(const char *s) {
+    if (strpbrk(s, ",\"\r\n") == NULL) {
+        fputs(s, stdout);
+        return;
+    }
+    putchar('"');
+    for (; *s; s++) {
+        if (*s == '"') {
+            putchar('"');
+        }
+        putchar(*s);
+    }
+    putchar('"');
+}
+
+// Write s as a JSON string
+static void printJsonString(const char *s) {
+    putchar('"');
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') {
+            printf("\\%c", c);
+        }
+        else if (c < 0x20) {
+            printf("\\u%04x", c);
+        }
+        else {
+            putchar(c);
+        }
+    }
+    putchar('"');
+}
+
+int runMeta(const char *const *paths, size_t count, metaFormat format, unsigned int jobs) {
+    fileList files = {0};
+    metaJob job;
+    size_t failed = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        collectFiles(&files, paths[i]);
+    }
+
+    job.paths = files.items;
+    job.results = (objMetadata *)calloc(files.count ? files.count : 1, sizeof(objMetadata));
+    job.status = (int *)calloc(files.count ? files.count : 1, sizeof(int));
+    if (!job.results || !job.status) {
+        fatal("Out of memory.");
+    }
+
+    parallelFor(files.count, jobs, scanOne, &job);
+
+    if (format == META_CSV) {
+        printf("file,status,name,start,length,entry\n");
+    }
+    else {
+        printf("[");
+    }
+
+    for (size_t i = 0; i < files.count; i++) {
+        const objMetadata *m = &job.results[i];
+        int ok = job.status[i] == 0;
+        failed += ok ? 0 : 1;
+
+        if (format == META_CSV) {
+            printCsvField(files.items[i]);
+            if (ok) {
+                printf(",ok,");
+                printCsvField(m->header.progName);
+                printf(",%06X,%06X,%06X\n", (unsigned int)m->header.startAddress,
+                       (unsigned int)m->header.programLength,
+                       (unsigned int)m->endRecord.firstExecAddress);
+            }
+            else {
+                printf(",error,,,,\n");
+            }
+        }
+        else {
+            printf("%s\n  {\"file\": ", i ? "," : "");
+            printJsonString(files.items[i]);
+            if (ok) {
+                printf(", \"status\": \"ok\", \"name\": ");
+                printJsonString(m->header.progName);
+                printf(", \"start\": \"%06X\", \"length\": \"%06X\", \"entry\": \"%06X\"}",
+                       (unsigned int)m->header.startAddress,
+                       (unsigned int)m->header.programLength,
+                       (unsigned int)m->endRecord.firstExecAddress);
+            }
+            else {
+                printf(", \"status\": \"error\"}");
+            }
+        }
+    }
+
+    if (format == META_JSON) {
+        printf("%s]\n", files.count ? "\n" : "");
+    }
+
+    for (size_t i = 0; i < files.count; i++) {
+        free(files.items[i]);
+    }
+    free(files.items);
+    free(job.results);
+    free(job.status);
+    return failed ? 1 : 0;
+}
@@ -1,5 +1,17 @@
 #include "objFile.h"
+#include "compress.h"
+#include "parallel.h"
+#include "trace.h"
 
+#include <stdarg.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define OBJ_HAVE_MMAP 1
+#endif
 
 /**
  * Implementation of the object file parser for SIC/SICXE.
@@ -12,6 +24,28 @@
  *         ModRecord, and EndRecord
  *       * Stores all records in a objFile structure
  *       * Performs basic validation (record order, lengths, addresses)
+ *       * Runs objValidateLayout() on the finished objFile, silently:
+ *         the first conflict is kept for objParseMessage()
+ *   - Implement objParseBuffer(), the same parser working on text that
+ *     is already in memory (objParseFile() reads small files with one
+ *     read(), maps larger ones, and calls it)
+ *   - Implement objParseBufferParallel() / objParseFileParallel(), which
+ *     parse the H record first, split the rest into newline-aligned
+ *     chunks parsed on worker threads, and then merge the chunks in file
+ *     order while checking that there is exactly one E record with nothing
+ *     after it. The result is identical to the sequential parser.
+ *   - Implement objCheckFile(), the same parse keeping only the byte span
+ *     of each T and M record, which goes through the same layout sweep
+ *     (checkLayout()) as objValidateLayout()
+ *   - Implement objScanMetadata(), which reads only the first record (H)
+ *     and the last non-blank line (E) of a file (compressed files have no
+ *     usable end, so they are decompressed and scanned whole)
+ *   - Read gzip / zstd compressed object files transparently: readSource()
+ *     checks the magic bytes (only those, for a file it would map), and
+ *     parseCompressedFile() parses each block of text the decompressor
+ *     (compress.h) produces while the tool works on the next one
+ *   - Implement objDecodeText() and objMarkModifiedText(), which let the
+ *     relocators decode only the T records an M record touches
  *   - Implement objFree(), which releases any dynamic memory
  *     allocated inside a objFile
  *
@@ -58,382 +92,1391 @@ static int parseFixedHex(const char *p, size_t len, uint32_t *out){
     return 1;
 }
 
-int objParseFile(const char *path, objFile *out) {
-    FILE *fp = NULL;
-    char line[256]; //Line being read from the object code file
-    textRecord *tRecords = NULL; // Array that holds the T records
-    modRecord  *mRecords = NULL; // Array that holds the M records
-    size_t tCapacity = 0, mCapacity = 0; // Capacity counters for the records arrays
-    size_t tCount = 0, mCount = 0; // Number of parsed records
-    int seenHRecord = 0; // flag indicating whether header record found
-    int seenERecord = 0; // flag indicating whether end record found
-    uint32_t progStart = 0; // Program starting address 
-    uint32_t headerLen = 0; // Program length in bytes
-    // For program length check
-    uint32_t minTextAddr = 0xFFFFFFFFU; // Address of the first text record
-    uint32_t maxTextAddr = 0; // Address of the last byte of the last text record
-
-    if(!path || !out){
-        return -1;
+// Value of one hex digit, or -1 if c is not a hex digit
+static int hexDigitValue(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
     }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
 
-    fp = fopen(path, "r");
-    if (!fp) {
-        return -1;
+// Copy the next line of src into line the way fgets() would: at most
+// size - 1 characters, stopping after a newline. Returns the number of
+// source bytes consumed (0 at end of input).
+static size_t nextLine(const char *src, size_t remaining, char *line, size_t size)
+{
+    size_t n = 0;
+
+    while (n < remaining && n < size - 1) {
+        line[n] = src[n];
+        if (src[n++] == '\n') {
+            break;
+        }
     }
+    line[n] = '\0';
+    return n;
+}
 
-    memset(out, 0, sizeof(*out));// initializes the output object file struct
+// Read the whole file at path into memory, mapping it when the platform allows.
+// A gzip or zstd file is not read: *format names its compression and *data
+// stays NULL. Small files are checked in the buffer of their single read();
+// a file that would be mapped has just its magic bytes read first.
+static int readSource(const char *path, char **data, size_t *length, int *mapped,
+                      compressFormat *format)
+{
+    *data = NULL;
+    *length = 0;
+    *mapped = 0;
+    *format = COMPRESS_NONE;
 
-    int error = 0; // Flag for succesfull parsing process (Assume succeed until failure)
-    int lineNum = 0; // Line number being read for the object file
+#ifdef OBJ_HAVE_MMAP
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
 
-    while (!error && fgets(line, sizeof(line), fp) != NULL){
-        lineNum++;
-        trimEolChars(line);
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return -1;
+    }
 
-        //Skip empty lines
-        int spaceLine = 1;
-        for (char *p = line; *p; ++p) {
-            if (!isspace((unsigned char)*p)) {
-                spaceLine = 0;// found non-space char
+    // Small files: one read() is cheaper than setting up and tearing down a mapping
+    if (st.st_size > 0 && (size_t)st.st_size <= OBJ_SMALL_FILE) {
+        char *buf = (char *)malloc((size_t)st.st_size);
+        size_t used = 0;
+        while (buf && used < (size_t)st.st_size) {
+            ssize_t got = read(fd, buf + used, (size_t)st.st_size - used);
+            if (got <= 0) {
                 break;
             }
+            used += (size_t)got;
         }
-        if(spaceLine) {
-            continue;// Continue to next line
+        if (buf && used == (size_t)st.st_size) {
+            close(fd);
+            *format = compressDetect(buf, used);
+            if (*format != COMPRESS_NONE) {
+                free(buf);
+                return 0;
+            }
+            *data = buf;
+            *length = used;
+            return 0;
+        }
+        free(buf);
+    }
+    else if (st.st_size > 0) {
+        uint8_t magic[COMPRESS_MAGIC_BYTES];
+        ssize_t got = pread(fd, magic, sizeof(magic), 0);
+        *format = compressDetect(magic, got > 0 ? (size_t)got : 0);
+        if (*format != COMPRESS_NONE) {
+            close(fd);
+            return 0;
         }
 
-        char recType = line[0];// Character with the record type of the line
-        const char *fields = line + 1;
-        // Skip any spaces immediately after the record type. Some object files
-        // include a separating space.
-        while (*fields == ' ' || *fields == '\t') {
-            ++fields;
+        void *view = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view != MAP_FAILED) {
+            close(fd);
+            *data = (char *)view;
+            *length = (size_t)st.st_size;
+            *mapped = 1;
+            return 0;
         }
-        switch (recType)
-        {
-        // Read in header record
-        case 'H':{
-            // Header must be first and unique
-            if (seenHRecord || tCount > 0 || mCount > 0 || seenERecord){
-                error = 1;
-                break;
-            }
-            // Some assemblers pad the program name to 6 chars with spaces,
-            // while others emit a shorter name followed by a single space
-            // before the start and length fields. Parse the name up to the
-            // next whitespace (max 6 chars) and then read the two required
-            // 6-digit hex fields with optional spacing in between.
-
-            const char *p = fields;
-            char sicProgName[7];
-            size_t nameLen = 0;
-
-            while (*p && !isspace((unsigned char)*p) && nameLen < sizeof(sicProgName) - 1) {
-                sicProgName[nameLen++] = *p++;
-            }
-            sicProgName[nameLen] = '\0';
+    }
+    close(fd);
+#endif
 
-            // Skip whitespace between name and start address
-            while (isspace((unsigned char)*p)) {
-                ++p;
-            }
+    // Fallback: read the file through stdio
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        return -1;
+    }
 
-            // Need at least 6 hex chars for the start address
-            if (strlen(p) < 6 || !parseFixedHex(p, 6, &progStart)) {
-                error = 1;
-                break;
+    char *buf = NULL;
+    size_t used = 0, capacity = 0;
+    for (;;) {
+        if (used == capacity) {
+            capacity = capacity ? capacity * 2 : 4096;
+            char *temp = (char *)realloc(buf, capacity);
+            if (!temp) {
+                free(buf);
+                fclose(fp);
+                return -1;
             }
-            p += 6;
+            buf = temp;
+        }
+        size_t got = fread(buf + used, 1, capacity - used, fp);
+        used += got;
+        if (got == 0) {
+            break;
+        }
+    }
 
-            // Skip whitespace between start address and program length
-            while (isspace((unsigned char)*p)) {
-                ++p;
-            }
+    if (ferror(fp)) {
+        free(buf);
+        fclose(fp);
+        return -1;
+    }
 
-            // Need at least 6 hex chars for the program length
-            if (strlen(p) < 6 || !parseFixedHex(p, 6, &headerLen)) {
-                error = 1;
-                break;
-            }
-            seenHRecord = 1;
+    fclose(fp);
+    *format = compressDetect(buf, used);
+    if (*format != COMPRESS_NONE) {
+        free(buf);
+        return 0;
+    }
+    *data = buf;
+    *length = used;
+    return 0;
+}
+
+static void releaseSource(char *data, size_t length, int mapped)
+{
+#ifdef OBJ_HAVE_MMAP
+    if (mapped) {
+        munmap(data, length);
+        return;
+    }
+#else
+    (void)mapped;
+#endif
+    (void)length;
+    free(data);
+}
 
-            // Fill header record in objfile struct
-            memset(&out->header, 0, sizeof(out->header));
-            strncpy(out->header.progName, sicProgName, sizeof(out->header.progName) - 1);
-            out->header.startAddress  = progStart;
-            out->header.programLength = headerLen;
+// Byte span [start, end) of a T record or M field, with its source line
+typedef struct {
+    uint64_t start;
+    uint64_t end;
+    uint32_t line;
+} layoutSpan;
 
-            break;
+static _Thread_local char layoutMessage[160]; // First conflict of the last parse on this thread
+
+// Running state of a parse: what has been seen so far and the records built
+typedef struct {
+    int checkOnly; // Validate records without storing them (objCheckFile())
+    textRecord *tRecords; // Array that holds the T records
+    modRecord  *mRecords; // Array that holds the M records
+    size_t tCapacity, mCapacity; // Capacity counters for the records arrays
+    size_t tCount, mCount; // Number of parsed records
+    int seenHRecord; // flag indicating whether header record found
+    int seenERecord; // flag indicating whether end record found
+    uint32_t progStart; // Program starting address 
+    uint32_t headerLen; // Program length in bytes
+    // For program length check
+    uint32_t minTextAddr; // Address of the first text record
+    uint32_t maxTextAddr; // Address of the last byte of the last text record
+    headerRecord header; // Parsed H record
+    endRecord endRecord; // Parsed E record
+    int lineNum; // Line number being read for the object file
+    size_t records; // Non-blank lines parsed so far
+    // checkOnly keeps just the byte spans, for the layout check
+    layoutSpan *tSpans, *mSpans;
+    size_t tSpanCapacity, mSpanCapacity;
+    size_t tSpanCount; // T records with a non-zero length
+    // The first records go here, so small files need no realloc() while parsing
+    textRecord tInline[OBJ_INLINE_RECORDS];
+    modRecord mInline[OBJ_INLINE_RECORDS];
+    layoutSpan tSpanInline[OBJ_INLINE_RECORDS];
+    layoutSpan mSpanInline[OBJ_INLINE_RECORDS];
+} parseState;
+
+static void initParseState(parseState *st, int checkOnly)
+{
+    st->checkOnly = checkOnly;
+    st->tRecords = st->tInline;
+    st->mRecords = st->mInline;
+    st->tCapacity = OBJ_INLINE_RECORDS;
+    st->mCapacity = OBJ_INLINE_RECORDS;
+    st->tCount = st->mCount = 0;
+    st->seenHRecord = st->seenERecord = 0;
+    st->progStart = st->headerLen = 0;
+    st->minTextAddr = 0xFFFFFFFFU;
+    st->maxTextAddr = 0;
+    memset(&st->header, 0, sizeof(st->header));
+    memset(&st->endRecord, 0, sizeof(st->endRecord));
+    st->lineNum = 0;
+    st->records = 0;
+    st->tSpans = st->tSpanInline;
+    st->mSpans = st->mSpanInline;
+    st->tSpanCapacity = OBJ_INLINE_RECORDS;
+    st->mSpanCapacity = OBJ_INLINE_RECORDS;
+    st->tSpanCount = 0;
+}
+
+static void freeParseState(parseState *st)
+{
+    if (st->tRecords != st->tInline) {
+        free(st->tRecords);
+    }
+    if (st->mRecords != st->mInline) {
+        free(st->mRecords);
+    }
+    if (st->tSpans != st->tSpanInline) {
+        free(st->tSpans);
+    }
+    if (st->mSpans != st->mSpanInline) {
+        free(st->mSpans);
+    }
+    st->tRecords = NULL;
+    st->mRecords = NULL;
+    st->tSpans = NULL;
+    st->mSpans = NULL;
+}
+
+// Grow a record array that may still be the inline one. Returns NULL on failure.
+static void *growRecords(void *records, const void *inlineRecords, size_t *capacity,
+                         size_t count, size_t size)
+{
+    size_t newCapacity = *capacity * 2;
+    void *grown;
+
+    if (records == inlineRecords) {
+        grown = malloc(newCapacity * size);
+        if (grown) {
+            memcpy(grown, records, count * size);
         }
-            
-        // Read in text record
-        case 'T':{
-            // detects if T record is before H record or after E record
-            if (!seenHRecord || seenERecord) {
-                error = 1;
-                break;
-            }
+    }
+    else {
+        grown = realloc(records, newCapacity * size);
+    }
+    if (grown) {
+        *capacity = newCapacity;
+    }
+    return grown;
+}
 
-            size_t lineLen = strlen(fields);
-            // Minimun size of T record payload: 6 addr + 2 len = 8 chars
-            if (lineLen < 8) {
-                error = 1;
-                break;
-            }
+// Read in header record. Returns 0 on success, -1 on error.
+static int parseHeaderRecord(parseState *st, const char *fields)
+{
+    // Header must be first and unique
+    if (st->seenHRecord || st->tCount > 0 || st->mCount > 0 || st->seenERecord){
+        return -1;
+    }
+    // Some assemblers pad the program name to 6 chars with spaces,
+    // while others emit a shorter name followed by a single space
+    // before the start and length fields. Parse the name up to the
+    // next whitespace (max 6 chars) and then read the two required
+    // 6-digit hex fields with optional spacing in between.
 
-            uint32_t addr = 0;
-            uint32_t tLen = 0;
+    const char *p = fields;
+    char sicProgName[7];
+    size_t nameLen = 0;
 
-            // Cols 2–7: address (6 hex), 8–9: length (2 hex)
-            if (!parseFixedHex(fields, 6, &addr) || !parseFixedHex(fields + 6, 2, &tLen)) {
-                error = 1;
-                break;
-            }
+    while (*p && !isspace((unsigned char)*p) && nameLen < sizeof(sicProgName) - 1) {
+        sicProgName[nameLen++] = *p++;
+    }
+    sicProgName[nameLen] = '\0';
 
-            // check T length has a valid lenght
-            if (tLen > MAX_T_BYTES) {
-                error = 1;
-                break;
-            }
+    // Skip whitespace between name and start address
+    while (isspace((unsigned char)*p)) {
+        ++p;
+    }
 
-            const char *hexBytes = fields + 8; // String with the hex bytes of the T record
-            size_t hexLen = strlen(hexBytes);// How many hex digits appear after the length field
-            // Check if the length of the hex bytes is correct 
-            if (hexLen != (size_t)tLen * 2U) {
-                error = 1;
-                break;
-            }
+    // Need at least 6 hex chars for the start address
+    if (strlen(p) < 6 || !parseFixedHex(p, 6, &st->progStart)) {
+        return -1;
+    }
+    p += 6;
 
-            // Basic range check if header length is non-zero
-            if (headerLen > 0) {
-                uint32_t progEnd = progStart + headerLen;// Calculates the program end address
-                uint32_t tEnd = addr + tLen; // Calculates the T record end address
-                // Checks if the Text  record is outside declared program range
-                if (addr < progStart || tEnd > progEnd) {
-                    error = 1;
-                    break;
-                }
-            }
+    // Skip whitespace between start address and program length
+    while (isspace((unsigned char)*p)) {
+        ++p;
+    }
 
-            // Grow text records array if needed 
-            if (tCount == tCapacity) {
-                if (tCapacity == 0) {
-                    tCapacity = 8;
-                } 
-                else {
-                    tCapacity *= 2;
-                }
-                textRecord *temp = (textRecord *)realloc( tRecords, tCapacity * sizeof(textRecord));
-                if (!temp) {
-                    error = 1;
-                    break;
-                }
-                tRecords = temp;
-            }
+    // Need at least 6 hex chars for the program length
+    if (strlen(p) < 6 || !parseFixedHex(p, 6, &st->headerLen)) {
+        return -1;
+    }
+    st->seenHRecord = 1;
 
-            textRecord *tr = &tRecords[tCount];
-            memset(tr, 0, sizeof(*tr));
-            tr->address = addr;
-            tr->length = tLen;
-
-            // Loop that Decodes hex string into bytes
-            for (uint32_t i = 0; i < tLen; ++i) {
-                char byteStr[3]; // Stores one byte(2 hex chars)
-                byteStr[0] = hexBytes[i * 2];
-                byteStr[1] = hexBytes[i * 2 + 1];
-                byteStr[2] = '\0';
-
-                // Converts the 2-char hex string into a numeric value
-                uint32_t byteVal = 0;
-                if (!parseFixedHex(byteStr, 2, &byteVal)) {
-                    error = 1;
-                    break;
-                }
-                tr->bytes[i] = (uint8_t)byteVal;// Stores the resulting byte in the text record struct
-            }
+    // Fill header record
+    memset(&st->header, 0, sizeof(st->header));
+    memcpy(st->header.progName, sicProgName, nameLen + 1);
+    st->header.startAddress  = st->progStart;
+    st->header.programLength = st->headerLen;
+    return 0;
+}
 
-            if (error) {
-                break;
-            }
+// Read in text record. hexSource is where fields starts in the source text.
+static int parseTextRecord(parseState *st, const char *fields, const char *hexSource)
+{
+    // detects if T record is before H record or after E record
+    if (!st->seenHRecord || st->seenERecord) {
+        return -1;
+    }
 
-            // Gets the min and max T record address of the program 
-            if (addr < minTextAddr) {
-                minTextAddr = addr;
-            }
-            if (addr + tLen > maxTextAddr) {
-                maxTextAddr = addr + tLen;
-            }
+    size_t lineLen = strlen(fields);
+    // Minimun size of T record payload: 6 addr + 2 len = 8 chars
+    if (lineLen < 8) {
+        return -1;
+    }
 
-            tCount++;
-            break;
+    uint32_t addr = 0;
+    uint32_t tLen = 0;
+
+    // Cols 2–7: address (6 hex), 8–9: length (2 hex)
+    if (!parseFixedHex(fields, 6, &addr) || !parseFixedHex(fields + 6, 2, &tLen)) {
+        return -1;
+    }
+
+    // check T length has a valid lenght
+    if (tLen > MAX_T_BYTES) {
+        return -1;
+    }
+
+    const char *hexBytes = fields + 8; // String with the hex bytes of the T record
+    size_t hexLen = strlen(hexBytes);// How many hex digits appear after the length field
+    // Check if the length of the hex bytes is correct 
+    if (hexLen != (size_t)tLen * 2U) {
+        return -1;
+    }
+
+    // Basic range check if header length is non-zero
+    if (st->headerLen > 0) {
+        uint32_t progEnd = st->progStart + st->headerLen;// Calculates the program end address
+        uint32_t tEnd = addr + tLen; // Calculates the T record end address
+        // Checks if the Text  record is outside declared program range
+        if (addr < st->progStart || tEnd > progEnd) {
+            return -1;
         }
-         
-        // Read in modification record
-        case 'M':{
-            if (!seenHRecord || seenERecord) {
-                // M before H or after E
-                error = 1;
-                break;
-            }
+    }
 
-            size_t len = strlen(fields);
-            // Minimun size of M record payload: 6 addr + 2 len + 1 sign = 9 chars.
-            if (len < 9) {
-                error = 1;
-                break;
+    // Validate the hex digits without decoding them. Lowercase digits
+    // can not be copied to the output as-is, so those records are
+    // decoded right away and re-encoded in uppercase later.
+    int upperOnly = 1;
+    for (size_t i = 0; i < hexLen; ++i) {
+        char c = hexBytes[i];
+        if (hexDigitValue(c) < 0) {
+            return -1;
+        }
+        if (c >= 'a' && c <= 'f') {
+            upperOnly = 0;
+        }
+    }
+
+    if (!st->checkOnly) {
+        // Grow text records array if needed 
+        if (st->tCount == st->tCapacity) {
+            textRecord *temp = (textRecord *)growRecords(st->tRecords, st->tInline, &st->tCapacity,
+                                                         st->tCount, sizeof(textRecord));
+            if (!temp) {
+                return -1;
             }
+            st->tRecords = temp;
+        }
 
-            uint32_t mAddr = 0; // Address where the loader must apply the relocation
-            uint32_t nibbles  = 0; // length of the field to modify, in nibbles
+        textRecord *tr = &st->tRecords[st->tCount];
+        memset(tr, 0, sizeof(*tr));
+        tr->address = addr;
+        tr->length = tLen;
+        tr->hexText = hexSource + 8;
+        tr->line = (uint32_t)st->lineNum;
 
-            // Checks that the address and the number of nibbles are in the correct format 
-            if (!parseFixedHex(fields, 6, &mAddr) || !parseFixedHex(fields + 6, 2, &nibbles)) {
-                error = 1;
-                break;
+        if (!upperOnly) {
+            objDecodeText(tr);
+        }
+    }
+    else if (tLen > 0) {
+        if (st->tSpanCount == st->tSpanCapacity) {
+            layoutSpan *temp = (layoutSpan *)growRecords(st->tSpans, st->tSpanInline,
+                                                         &st->tSpanCapacity, st->tSpanCount,
+                                                         sizeof(layoutSpan));
+            if (!temp) {
+                return -1;
             }
+            st->tSpans = temp;
+        }
 
-            // Check for correct characters (+ , -)
-            char sign = fields[8];
-            if (sign != '+' && sign != '-') {
-                error = 1;
-                break;
-            }
+        layoutSpan *span = &st->tSpans[st->tSpanCount++];
+        span->start = addr;
+        span->end = (uint64_t)addr + tLen;
+        span->line = (uint32_t)st->lineNum;
+    }
 
-            // Verifies that the lengthNibbles should be > 0 
-            if (nibbles == 0 || nibbles > 0xFFU) {
-                error = 1;
-                break;
-            }
+    // Gets the min and max T record address of the program 
+    if (addr < st->minTextAddr) {
+        st->minTextAddr = addr;
+    }
+    if (addr + tLen > st->maxTextAddr) {
+        st->maxTextAddr = addr + tLen;
+    }
 
-            // Grow modification records array if needed 
-            if (mCount == mCapacity) {
-                if (mCapacity == 0){
-                   mCapacity = 8;
-                }
-                else{
-                    mCapacity *= 2;
-                }
-                modRecord *temp = (modRecord *)realloc(mRecords, mCapacity * sizeof(modRecord));
-                if (!temp) {
-                    error = 1;
-                    break;
-                }
-                mRecords = temp;
-            }
+    st->tCount++;
+    return 0;
+}
 
-            modRecord *mr = &mRecords[mCount];
-            memset(mr, 0, sizeof(*mr));
-            mr->address = mAddr;
-            mr->lengthNibbles = (uint8_t)nibbles;
-            mr->sign = sign;
-
-            // Check mod record address vs. program length
-            if (headerLen > 0) {
-                uint32_t headerEnd = progStart + headerLen;
-                if (mAddr < progStart || mAddr >= headerEnd) {
-                    // Modification outside program range
-                    error = 1;
-                    break;
-                }
-            }
+// Read in modification record
+static int parseModRecord(parseState *st, const char *fields)
+{
+    if (!st->seenHRecord || st->seenERecord) {
+        // M before H or after E
+        return -1;
+    }
 
-            mCount++;
-            break;
-        }
+    size_t len = strlen(fields);
+    // Minimun size of M record payload: 6 addr + 2 len + 1 sign = 9 chars.
+    if (len < 9) {
+        return -1;
+    }
 
-        // Read in end record
-        case 'E':{
-            if (!seenHRecord || seenERecord) {
-                // E before H or multiple E records
-                error = 1;
-                break;
-            }
+    uint32_t mAddr = 0; // Address where the loader must apply the relocation
+    uint32_t nibbles  = 0; // length of the field to modify, in nibbles
 
-            size_t lineLen = strlen(fields);
-            // E record payload: 6 address chars
-            if (lineLen < 6) {
-                error = 1;
-                break;
-            }
+    // Checks that the address and the number of nibbles are in the correct format 
+    if (!parseFixedHex(fields, 6, &mAddr) || !parseFixedHex(fields + 6, 2, &nibbles)) {
+        return -1;
+    }
 
-            uint32_t execAddr = 0;
-            if (!parseFixedHex(fields, 6, &execAddr)) {
-                error = 1;
-                break;
-            }
+    // Check for correct characters (+ , -)
+    char sign = fields[8];
+    if (sign != '+' && sign != '-') {
+        return -1;
+    }
 
-            // Basic check: if headerLen > 0, entry point should be in range
-            if (headerLen > 0) {
-                uint32_t headerEnd = progStart + headerLen;
-                if (execAddr < progStart || execAddr >= headerEnd) {
-                    // Invalid program addresses
-                    error = 1;
-                    break;
-                }
-            }
+    // Verifies that the lengthNibbles should be > 0 
+    if (nibbles == 0 || nibbles > 0xFFU) {
+        return -1;
+    }
 
-            out->endRecord.firstExecAddress = execAddr;
-            seenERecord = 1;
-            break;
-        }  
+    // Check mod record address vs. program length
+    if (st->headerLen > 0) {
+        uint32_t headerEnd = st->progStart + st->headerLen;
+        if (mAddr < st->progStart || mAddr >= headerEnd) {
+            // Modification outside program range
+            return -1;
+        }
+    }
 
-        default:
-            // Invalid record
-            error = 1;
-            break;
-        }// end switch
-    }// end while
-    
-    // Error validation
-    if (!error){
-        // Check that the program has exactly one header and one end record
-        if (!seenHRecord || !seenERecord) {
-            error = 1;
+    if (!st->checkOnly) {
+        // Grow modification records array if needed 
+        if (st->mCount == st->mCapacity) {
+            modRecord *temp = (modRecord *)growRecords(st->mRecords, st->mInline, &st->mCapacity,
+                                                       st->mCount, sizeof(modRecord));
+            if (!temp) {
+                return -1;
+            }
+            st->mRecords = temp;
         }
+
+        modRecord *mr = &st->mRecords[st->mCount];
+        memset(mr, 0, sizeof(*mr));
+        mr->address = mAddr;
+        mr->lengthNibbles = (uint8_t)nibbles;
+        mr->sign = sign;
+        mr->line = (uint32_t)st->lineNum;
     }
-    
-    if (!error && tCount > 0 && headerLen > 0) {
-        // If text records are present and non-zero program length, check the overall range
-        uint32_t headerEnd = progStart + headerLen;
-        if (minTextAddr < progStart || maxTextAddr > headerEnd) {
-            error = 1;
+    else {
+        if (st->mCount == st->mSpanCapacity) {
+            layoutSpan *temp = (layoutSpan *)growRecords(st->mSpans, st->mSpanInline,
+                                                         &st->mSpanCapacity, st->mCount,
+                                                         sizeof(layoutSpan));
+            if (!temp) {
+                return -1;
+            }
+            st->mSpans = temp;
         }
+
+        layoutSpan *span = &st->mSpans[st->mCount];
+        span->start = mAddr;
+        span->end = (uint64_t)mAddr + (uint64_t)((nibbles + 1) / 2);
+        span->line = (uint32_t)st->lineNum;
     }
 
-    if (error) {
-        // On failure, free the records arrays and reset out
-        free(tRecords);
-        free(mRecords);
-        memset(out, 0, sizeof(*out));
-        fclose(fp);
+    st->mCount++;
+    return 0;
+}
+
+// Read in end record
+static int parseEndRecord(parseState *st, const char *fields)
+{
+    if (!st->seenHRecord || st->seenERecord) {
+        // E before H or multiple E records
         return -1;
     }
 
-    // If no errors, build the output objFile
-    out->textRecords = tRecords;
-    out->textCount = tCount;
-    out->modRecords = mRecords;
-    out->modCount = mCount;
+    size_t lineLen = strlen(fields);
+    // E record payload: 6 address chars
+    if (lineLen < 6) {
+        return -1;
+    }
 
-    fclose(fp);
+    uint32_t execAddr = 0;
+    if (!parseFixedHex(fields, 6, &execAddr)) {
+        return -1;
+    }
+
+    // Basic check: if headerLen > 0, entry point should be in range
+    if (st->headerLen > 0) {
+        uint32_t headerEnd = st->progStart + st->headerLen;
+        if (execAddr < st->progStart || execAddr >= headerEnd) {
+            // Invalid program addresses
+            return -1;
+        }
+    }
+
+    st->endRecord.firstExecAddress = execAddr;
+    st->seenERecord = 1;
     return 0;
 }
 
-void objFree(objFile *file) {
-    if (!file) {
-        return;
-    }
+// Parse the lines of data into st, stopping after maxRecords records when it
+// is non-zero. *consumed (if given) receives the number of bytes parsed.
+// Returns 0 on success, -1 on the first error.
+static int parseLines(parseState *st, const char *data, size_t length,
+                      size_t maxRecords, size_t *consumed)
+{
+    char line[256]; //Line being read from the object code file
+    size_t pos = 0; // Offset of the next line in the source text
+    size_t parsed = 0; // Records parsed by this call
 
-    // free records arrays
-    free(file->textRecords);
-    free(file->modRecords);
+    while (pos < length && (maxRecords == 0 || parsed < maxRecords)){
+        const char *lineStart = data + pos; // Source position of the line copied into line[]
+        pos += nextLine(lineStart, length - pos, line, sizeof(line));
+        st->lineNum++;
+        trimEolChars(line);
+
+        //Skip empty lines
+        int spaceLine = 1;
+        for (char *p = line; *p; ++p) {
+            if (!isspace((unsigned char)*p)) {
+                spaceLine = 0;// found non-space char
+                break;
+            }
+        }
+        if(spaceLine) {
+            continue;// Continue to next line
+        }
+        parsed++;
+        st->records++;
+
+        char recType = line[0];// Character with the record type of the line
+        const char *fields = line + 1;
+        // Skip any spaces immediately after the record type. Some object files
+        // include a separating space.
+        while (*fields == ' ' || *fields == '\t') {
+            ++fields;
+        }
+
+        int error;
+        switch (recType)
+        {
+        case 'H':
+            error = parseHeaderRecord(st, fields);
+            break;
+        case 'T':
+            error = parseTextRecord(st, fields, lineStart + (fields - line));
+            break;
+        case 'M':
+            error = parseModRecord(st, fields);
+            break;
+        case 'E':
+            error = parseEndRecord(st, fields);
+            break;
+        default:
+            // Invalid record
+            error = -1;
+            break;
+        }// end switch
+
+        if (error) {
+            return -1;
+        }
+    }// end while
+
+    if (consumed) {
+        *consumed = pos;
+    }
+    return 0;
+}
+
+// Checks that only make sense once the whole file has been read
+static int finishParse(const parseState *st)
+{
+    // Check that the program has exactly one header and one end record
+    if (!st->seenHRecord || !st->seenERecord) {
+        return -1;
+    }
+    
+    if (st->tCount > 0 && st->headerLen > 0) {
+        // If text records are present and non-zero program length, check the overall range
+        uint32_t headerEnd = st->progStart + st->headerLen;
+        if (st->minTextAddr < st->progStart || st->maxTextAddr > headerEnd) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Hand the records collected in st over to out and check their layout
+static int buildObjFile(parseState *st, objFile *out)
+{
+    // Records still in the inline arrays move to one exact-size allocation each
+    if (st->tRecords == st->tInline) {
+        st->tRecords = (textRecord *)malloc((st->tCount ? st->tCount : 1) * sizeof(textRecord));
+        if (!st->tRecords) {
+            freeParseState(st);
+            return -1;
+        }
+        memcpy(st->tRecords, st->tInline, st->tCount * sizeof(textRecord));
+    }
+    if (st->mRecords == st->mInline) {
+        st->mRecords = (modRecord *)malloc((st->mCount ? st->mCount : 1) * sizeof(modRecord));
+        if (!st->mRecords) {
+            freeParseState(st);
+            return -1;
+        }
+        memcpy(st->mRecords, st->mInline, st->mCount * sizeof(modRecord));
+    }
+
+    out->header = st->header;
+    out->endRecord = st->endRecord;
+    out->textRecords = st->tRecords;
+    out->textCount = st->tCount;
+    out->modRecords = st->mRecords;
+    out->modCount = st->mCount;
+    st->tRecords = NULL;
+    st->mRecords = NULL;
+
+    // Overlapping T records or M fields outside loaded text. Nothing is
+    // printed here; the first conflict is kept for objParseMessage().
+    if (objValidateLayout(out, NULL) != 0) {
+        objFree(out);
+        return -1;
+    }
+    return 0;
+}
+
+// Parse a compressed file while its decompressor is still running. The text
+// is read in blocks and the complete lines of each block are parsed before
+// the next one is read. It stays in one buffer, since the T records point
+// into it; when the buffer grows, the records parsed so far are moved over.
+// On success *data / *length hold the decompressed text.
+static int parseCompressedFile(const char *path, compressFormat format, parseState *st,
+                               char **data, size_t *length)
+{
+    compressStream stream;
+    char *buf = NULL;
+    size_t used = 0, capacity = 0;
+    size_t parsed = 0; // Bytes already handed to parseLines()
+    int error = 0;
+
+    *data = NULL;
+    *length = 0;
+    if (compressOpenRead(path, format, &stream) != 0) {
+        return -1;
+    }
+
+    for (;;) {
+        if (used == capacity) {
+            size_t newCapacity = capacity ? capacity * 2 : OBJ_STREAM_BLOCK;
+            char *grown = (char *)malloc(newCapacity);
+            if (!grown) {
+                error = 1;
+                break;
+            }
+            if (used > 0) {
+                memcpy(grown, buf, used);
+            }
+            for (size_t i = 0; i < st->tCount && !st->checkOnly; i++) {
+                st->tRecords[i].hexText = grown + (st->tRecords[i].hexText - buf);
+            }
+            free(buf);
+            buf = grown;
+            capacity = newCapacity;
+        }
+
+        size_t want = capacity - used;
+        if (want > OBJ_STREAM_BLOCK) {
+            want = OBJ_STREAM_BLOCK;
+        }
+        size_t got = fread(buf + used, 1, want, stream.fp);
+        used += got;
+
+        // Up to the last complete line; a partial line waits for the next block
+        size_t end = used;
+        while (got > 0 && end > parsed && buf[end - 1] != '\n') {
+            end--;
+        }
+        if (end > parsed) {
+            size_t consumed = 0;
+            if (parseLines(st, buf + parsed, end - parsed, 0, &consumed) != 0) {
+                error = 1;
+                break;
+            }
+            parsed += consumed;
+        }
+        if (got == 0) {
+            break;
+        }
+    }
+
+    // After an early stop the tool dies on the closed pipe, so this fails too
+    if (compressClose(&stream) != 0) {
+        error = 1;
+    }
+    if (error) {
+        free(buf);
+        return -1;
+    }
+    *data = buf;
+    *length = used;
+    return 0;
+}
+
+int objParseFile(const char *path, objFile *out) {
+    return objParseFileParallel(path, out, 1);
+}
+
+int objParseFileParallel(const char *path, objFile *out, unsigned int jobs) {
+    char *data = NULL;
+    size_t length = 0;
+    int mapped = 0;
+
+    if(!path || !out){
+        return -1;
+    }
+
+    uint64_t spanStart = traceNow();
+    compressFormat format;
+    if (readSource(path, &data, &length, &mapped, &format) != 0) {
+        return -1;
+    }
+    traceSpan("open", path, spanStart, length, 0);
+
+    spanStart = traceNow();
+    if (format != COMPRESS_NONE) {
+        // Parsed line by line as the decompressor produces the text, so
+        // there is no whole buffer to split between threads
+        parseState st;
+        memset(out, 0, sizeof(*out));
+        layoutMessage[0] = '\0';
+        initParseState(&st, 0);
+        if (parseCompressedFile(path, format, &st, &data, &length) != 0 ||
+            finishParse(&st) != 0) {
+            freeParseState(&st);
+            free(data);
+            return -1;
+        }
+        if (buildObjFile(&st, out) != 0) {
+            free(data);
+            return -1;
+        }
+        traceSpan("parse", path, spanStart, length, out->textCount + out->modCount);
+        out->source = data;
+        out->sourceLength = length;
+        out->sourceMapped = 0;
+        return 0;
+    }
+
+    if (objParseBufferParallel(data, length, out, jobs) != 0) {
+        releaseSource(data, length, mapped);
+        return -1;
+    }
+    traceSpan("parse", path, spanStart, length, out->textCount + out->modCount);
+
+    // The T records point into the source text, so the objFile keeps it
+    out->source = data;
+    out->sourceLength = length;
+    out->sourceMapped = mapped;
+    return 0;
+}
+
+int objParseBuffer(const char *data, size_t length, objFile *out) {
+    parseState st;
+
+    if((!data && length > 0) || !out){
+        return -1;
+    }
+
+    memset(out, 0, sizeof(*out));// initializes the output object file struct
+    layoutMessage[0] = '\0';
+    initParseState(&st, 0);
+
+    if (parseLines(&st, data, length, 0, NULL) != 0 || finishParse(&st) != 0) {
+        // On failure, free the records arrays and leave out reset
+        freeParseState(&st);
+        return -1;
+    }
+
+    // If no errors, build the output objFile
+    return buildObjFile(&st, out);
+}
+
+// One newline-aligned slice of the source parsed by a worker thread
+typedef struct {
+    const char *data; // First byte of the chunk
+    size_t length; // Chunk size in bytes
+    parseState st; // Records and E/line bookkeeping of this chunk only
+    int error; // Result of parseLines() on the chunk
+} parseChunk;
+
+static void parseChunkTask(size_t index, void *ctx)
+{
+    parseChunk *chunk = &((parseChunk *)ctx)[index];
+    uint64_t spanStart = traceNow();
+
+    chunk->error = parseLines(&chunk->st, chunk->data, chunk->length, 0, NULL);
+    traceSpan("parse chunk", chunk->st.header.progName, spanStart, chunk->length, chunk->st.records);
+}
+
+int objParseBufferParallel(const char *data, size_t length, objFile *out, unsigned int jobs) {
+    if (jobs > length / OBJ_PARALLEL_MIN_CHUNK) {
+        jobs = (unsigned int)(length / OBJ_PARALLEL_MIN_CHUNK);
+    }
+    if (jobs <= 1) {
+        return objParseBuffer(data, length, out);
+    }
+    if (!data || !out) {
+        return -1;
+    }
+
+    memset(out, 0, sizeof(*out));
+    layoutMessage[0] = '\0';
+
+    // The H record has to be the first record, and every chunk needs its
+    // range, so parse it on its own first
+    parseState st;
+    size_t pos = 0;
+    initParseState(&st, 0);
+    if (parseLines(&st, data, length, 1, &pos) != 0 || !st.seenHRecord) {
+        freeParseState(&st);
+        return -1;
+    }
+
+    parseChunk *chunks = (parseChunk *)calloc(jobs, sizeof(*chunks));
+    if (!chunks) {
+        return -1;
+    }
+
+    // Cut the rest into chunks that each start right after a newline,
+    // which is always where the sequential parser starts a line too
+    size_t rest = length - pos;
+    size_t start = pos;
+    for (unsigned int k = 0; k < jobs; k++) {
+        size_t end = (k == jobs - 1) ? length : pos + rest / jobs * (k + 1);
+        if (end < start) {
+            end = start;
+        }
+        if (end < length && end > 0 && data[end - 1] != '\n') {
+            const char *nl = (const char *)memchr(data + end, '\n', length - end);
+            end = nl ? (size_t)(nl - data) + 1 : length;
+        }
+
+        parseChunk *c = &chunks[k];
+        c->data = data + start;
+        c->length = end - start;
+        initParseState(&c->st, 0);
+        c->st.seenHRecord = 1; // so a second H in the chunk is rejected
+        c->st.progStart = st.progStart;
+        c->st.headerLen = st.headerLen;
+        c->st.header = st.header;
+        start = end;
+    }
+
+    parallelFor(jobs, jobs, parseChunkTask, chunks);
+
+    // Sequential fixup: one E record in total and no record after it
+    int error = 0;
+    size_t endChunk = jobs; // Chunk holding the E record
+    size_t tTotal = 0, mTotal = 0;
+    for (unsigned int k = 0; k < jobs; k++) {
+        const parseState *cs = &chunks[k].st;
+        if (chunks[k].error) {
+            error = 1;
+        }
+        if (endChunk != jobs && cs->records > 0) {
+            error = 1; // Anything after the E record, including another E
+        }
+        if (cs->seenERecord && endChunk == jobs) {
+            endChunk = k;
+        }
+        tTotal += cs->tCount;
+        mTotal += cs->mCount;
+    }
+
+    if (!error) {
+        st.tRecords = (textRecord *)malloc((tTotal ? tTotal : 1) * sizeof(textRecord));
+        st.mRecords = (modRecord *)malloc((mTotal ? mTotal : 1) * sizeof(modRecord));
+        if (!st.tRecords || !st.mRecords) {
+            error = 1;
+        }
+    }
+
+    // Merge the chunk records in file order, turning chunk line numbers
+    // into file line numbers
+    for (unsigned int k = 0; k < jobs && !error; k++) {
+        const parseState *cs = &chunks[k].st;
+        uint32_t lineOffset = (uint32_t)st.lineNum;
+
+        for (size_t i = 0; i < cs->tCount; i++) {
+            st.tRecords[st.tCount] = cs->tRecords[i];
+            st.tRecords[st.tCount++].line += lineOffset;
+        }
+        for (size_t i = 0; i < cs->mCount; i++) {
+            st.mRecords[st.mCount] = cs->mRecords[i];
+            st.mRecords[st.mCount++].line += lineOffset;
+        }
+        if (cs->tCount > 0) {
+            if (cs->minTextAddr < st.minTextAddr) {
+                st.minTextAddr = cs->minTextAddr;
+            }
+            if (cs->maxTextAddr > st.maxTextAddr) {
+                st.maxTextAddr = cs->maxTextAddr;
+            }
+        }
+        st.lineNum += cs->lineNum;
+        st.records += cs->records;
+    }
+
+    if (!error && endChunk != jobs) {
+        st.seenERecord = 1;
+        st.endRecord = chunks[endChunk].st.endRecord;
+    }
+
+    for (unsigned int k = 0; k < jobs; k++) {
+        freeParseState(&chunks[k].st);
+    }
+    free(chunks);
+
+    if (error || finishParse(&st) != 0) {
+        freeParseState(&st);
+        return -1;
+    }
+    return buildObjFile(&st, out);
+}
+
+// qsort comparator ordering spans by start address, then by line
+static int compareSpan(const void *a, const void *b)
+{
+    const layoutSpan *sa = (const layoutSpan *)a;
+    const layoutSpan *sb = (const layoutSpan *)b;
+
+    if (sa->start != sb->start) {
+        return (sa->start < sb->start) ? -1 : 1;
+    }
+    if (sa->line != sb->line) {
+        return (sa->line < sb->line) ? -1 : 1;
+    }
+    return 0;
+}
+
+// One layout conflict: written to report (when not NULL) as an "Error:" line,
+// and kept for objParseMessage() if it is the first since the parse started
+static void layoutConflict(FILE *report, const char *format, ...)
+{
+    char msg[sizeof(layoutMessage)];
+    va_list args;
+
+    va_start(args, format);
+    vsnprintf(msg, sizeof(msg), format, args);
+    va_end(args);
+
+    if (report) {
+        fprintf(report, "Error: %s\n", msg);
+    }
+    if (layoutMessage[0] == '\0') {
+        memcpy(layoutMessage, msg, sizeof(msg));
+    }
+}
+
+const char *objParseMessage(void) {
+    return layoutMessage[0] ? layoutMessage : NULL;
+}
+
+// Sort the spans and sweep them: T records may not overlap and every M field
+// must lie inside loaded text. text[] is merged in place. Returns the number
+// of conflicts, each described on report when it is not NULL.
+static int checkLayout(layoutSpan *text, size_t textSpans, layoutSpan *fields,
+                       size_t fieldCount, FILE *report)
+{
+    qsort(text, textSpans, sizeof(*text), compareSpan);
+    qsort(fields, fieldCount, sizeof(*fields), compareSpan);
+
+    int conflicts = 0;
+
+    // Sweep the T records, reporting overlaps and merging touching records
+    // into runs of contiguous loaded text (kept in place at the front of text[])
+    size_t runs = 0;
+    uint32_t ownerLine = 0; // Line of the record that reaches furthest so far
+    for (size_t i = 0; i < textSpans; i++) {
+        layoutSpan cur = text[i];
+
+        if (runs > 0 && cur.start < text[runs - 1].end) {
+            conflicts++;
+            layoutConflict(report, "line %u: T record at %06llX overlaps T record on line %u",
+                           (unsigned int)cur.line, (unsigned long long)cur.start, (unsigned int)ownerLine);
+        }
+
+        if (runs > 0 && cur.start <= text[runs - 1].end) {
+            if (cur.end > text[runs - 1].end) {
+                text[runs - 1].end = cur.end;
+                ownerLine = cur.line;
+            }
+        }
+        else {
+            text[runs++] = cur;
+            ownerLine = cur.line;
+        }
+    }
+
+    // Sweep the M fields (sorted by start) against the runs of loaded text
+    size_t r = 0;
+    for (size_t i = 0; i < fieldCount; i++) {
+        const layoutSpan *f = &fields[i];
+
+        while (r < runs && text[r].end <= f->start) {
+            r++;
+        }
+
+        if (r == runs || text[r].start > f->start) {
+            conflicts++;
+            layoutConflict(report, "line %u: M record field at %06llX is not inside any T record",
+                           (unsigned int)f->line, (unsigned long long)f->start);
+        }
+        else if (f->end > text[r].end) {
+            conflicts++;
+            layoutConflict(report, "line %u: M record field %06llX-%06llX extends past loaded text ending at %06llX",
+                           (unsigned int)f->line, (unsigned long long)f->start,
+                           (unsigned long long)(f->end - 1), (unsigned long long)(text[r].end - 1));
+        }
+    }
+
+    return conflicts;
+}
+
+int objCheckFile(const char *path) {
+    char *data = NULL;
+    size_t length = 0;
+    int mapped = 0;
+    parseState st;
+
+    if (!path) {
+        return -1;
+    }
+
+    uint64_t spanStart = traceNow();
+    compressFormat format;
+    if (readSource(path, &data, &length, &mapped, &format) != 0) {
+        return -1;
+    }
+
+    // Structure, range and hex-digit checks, then the layout check on the
+    // record spans: no record arrays, no decoding
+    layoutMessage[0] = '\0';
+    initParseState(&st, 1);
+    int parsed = (format != COMPRESS_NONE) ? parseCompressedFile(path, format, &st, &data, &length)
+                                           : parseLines(&st, data, length, 0, NULL);
+    int result = (parsed == 0 && finishParse(&st) == 0 &&
+                  checkLayout(st.tSpans, st.tSpanCount, st.mSpans, st.mCount, NULL) == 0) ? 0 : -1;
+
+    freeParseState(&st);
+    releaseSource(data, length, mapped);
+    traceSpan("check", path, spanStart, length, st.tCount + st.mCount);
+    return result;
+}
+
+// objScanMetadata() for a compressed file: the same first and last record,
+// taken from the decompressed text
+static int scanCompressedMetadata(const char *path, compressFormat format, objMetadata *out) {
+    char *data = NULL;
+    size_t length = 0;
+    parseState st;
+    int result = -1;
+
+    if (compressReadFile(path, format, &data, &length) != 0) {
+        return -1;
+    }
+
+    size_t end = length;
+    while (end > 0 && isspace((unsigned char)data[end - 1])) {
+        end--;
+    }
+    size_t lineStart = end;
+    while (lineStart > 0 && data[lineStart - 1] != '\n') {
+        lineStart--;
+    }
+
+    size_t headLength = (length < OBJ_META_HEAD_BYTES) ? length : OBJ_META_HEAD_BYTES;
+    initParseState(&st, 1);
+    if (parseLines(&st, data, headLength, 1, NULL) == 0 && st.seenHRecord &&
+        parseLines(&st, data + lineStart, length - lineStart, 1, NULL) == 0 && st.seenERecord) {
+        out->header = st.header;
+        out->endRecord = st.endRecord;
+        result = 0;
+    }
+
+    free(data);
+    return result;
+}
+
+int objScanMetadata(const char *path, objMetadata *out) {
+    char head[OBJ_META_HEAD_BYTES];
+    char *tail = NULL;
+    parseState st;
+    int result = -1;
+
+    if (!path || !out) {
+        return -1;
+    }
+    memset(out, 0, sizeof(*out));
+
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        return -1;
+    }
+
+    // H record: the first record of the file
+    size_t headLength = fread(head, 1, sizeof(head), fp);
+    compressFormat format = compressDetect(head, headLength);
+    if (format != COMPRESS_NONE) {
+        fclose(fp);
+        return scanCompressedMetadata(path, format, out);
+    }
+    initParseState(&st, 1);
+    if (parseLines(&st, head, headLength, 1, NULL) != 0 || !st.seenHRecord) {
+        fclose(fp);
+        return -1;
+    }
+
+    // E record: the last non-blank line. Read a block from the end of the
+    // file and double it until it holds that whole line.
+    if (fseek(fp, 0, SEEK_END) != 0) {
+        fclose(fp);
+        return -1;
+    }
+    long size = ftell(fp);
+    size_t want = OBJ_META_TAIL_BYTES;
+    while (size > 0) {
+        if (want > (size_t)size) {
+            want = (size_t)size;
+        }
+        char *temp = (char *)realloc(tail, want);
+        if (!temp || fseek(fp, size - (long)want, SEEK_SET) != 0 ||
+            fread(temp, 1, want, fp) != want) {
+            tail = temp ? temp : tail;
+            break;
+        }
+        tail = temp;
+
+        size_t end = want;
+        while (end > 0 && isspace((unsigned char)tail[end - 1])) {
+            end--;
+        }
+        size_t lineStart = end;
+        while (lineStart > 0 && tail[lineStart - 1] != '\n') {
+            lineStart--;
+        }
+        if (lineStart == 0 && want < (size_t)size) {
+            want *= 2; // the line may start before this block
+            continue;
+        }
+
+        if (parseLines(&st, tail + lineStart, want - lineStart, 1, NULL) == 0 && st.seenERecord) {
+            out->header = st.header;
+            out->endRecord = st.endRecord;
+            result = 0;
+        }
+        break;
+    }
+
+    free(tail);
+    fclose(fp);
+    return result;
+}
+
+int objDecodeHex(const char *hex, size_t byteCount, uint8_t *out) {
+    if ((!hex || !out) && byteCount > 0) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < byteCount; ++i) {
+        int hi = hexDigitValue(hex[i * 2]);
+        int lo = hexDigitValue(hex[i * 2 + 1]);
+        if (hi < 0 || lo < 0) {
+            return -1;
+        }
+        out[i] = (uint8_t)((hi << 4) | lo);
+    }
+    return 0;
+}
+
+int objDecodeText(textRecord *t) {
+    if (!t) {
+        return -1;
+    }
+    if (t->decoded) {
+        return 0;
+    }
+    if (objDecodeHex(t->hexText, t->length, t->bytes) != 0) {
+        return -1;
+    }
+
+    t->decoded = 1;
+    return 0;
+}
+
+// qsort comparator ordering text record pointers by load address
+static int compareTextAddress(const void *a, const void *b)
+{
+    const textRecord *ta = *(const textRecord *const *)a;
+    const textRecord *tb = *(const textRecord *const *)b;
+
+    if (ta->address != tb->address) {
+        return (ta->address < tb->address) ? -1 : 1;
+    }
+    return 0;
+}
+
+int objValidateLayout(const objFile *obj, FILE *report) {
+    if (!obj) {
+        return -1;
+    }
+    if (obj->textCount == 0 && obj->modCount == 0) {
+        return 0;
+    }
+
+    layoutSpan *text = (layoutSpan *)malloc((obj->textCount + 1) * sizeof(*text));
+    layoutSpan *fields = (layoutSpan *)malloc((obj->modCount + 1) * sizeof(*fields));
+    if (!text || !fields) {
+        free(text);
+        free(fields);
+        return -1;
+    }
+
+    size_t textSpans = 0;
+    for (size_t i = 0; i < obj->textCount; i++) {
+        const textRecord *t = &obj->textRecords[i];
+        if (t->length == 0) {
+            continue;
+        }
+        text[textSpans].start = t->address;
+        text[textSpans].end = (uint64_t)t->address + t->length;
+        text[textSpans].line = t->line;
+        textSpans++;
+    }
+    for (size_t i = 0; i < obj->modCount; i++) {
+        const modRecord *m = &obj->modRecords[i];
+        fields[i].start = m->address;
+        fields[i].end = (uint64_t)m->address + (uint64_t)((m->lengthNibbles + 1) / 2);
+        fields[i].line = m->line;
+    }
+
+    int conflicts = checkLayout(text, textSpans, fields, obj->modCount, report);
+
+    free(text);
+    free(fields);
+    return conflicts;
+}
+
+int objMarkModifiedText(objFile *obj) {
+    if (!obj) {
+        return -1;
+    }
+    if (obj->textCount == 0) {
+        return 0;
+    }
+
+    // Sort the records by address and keep the running maximum end address,
+    // so each M field only has to look at the records that can reach it.
+    // Small programs use scratch space on the stack.
+    textRecord *sortedInline[OBJ_INLINE_RECORDS];
+    uint64_t maxEndInline[OBJ_INLINE_RECORDS];
+    textRecord **sorted = sortedInline;
+    uint64_t *maxEnd = maxEndInline;
+    if (obj->textCount > OBJ_INLINE_RECORDS) {
+        sorted = (textRecord **)malloc(obj->textCount * sizeof(*sorted));
+        maxEnd = (uint64_t *)malloc(obj->textCount * sizeof(*maxEnd));
+        if (!sorted || !maxEnd) {
+            free(sorted);
+            free(maxEnd);
+            return -1;
+        }
+    }
+
+    for (size_t i = 0; i < obj->textCount; i++) {
+        sorted[i] = &obj->textRecords[i];
+        sorted[i]->modified = 0;
+    }
+    qsort(sorted, obj->textCount, sizeof(*sorted), compareTextAddress);
+
+    int overlapping = 0; // T records that share bytes must all go through memory
+    for (size_t i = 0; i < obj->textCount; i++) {
+        uint64_t end = (uint64_t)sorted[i]->address + sorted[i]->length;
+        if (i > 0 && sorted[i]->length > 0 && sorted[i]->address < maxEnd[i - 1]) {
+            overlapping = 1;
+        }
+        maxEnd[i] = (i > 0 && maxEnd[i - 1] > end) ? maxEnd[i - 1] : end;
+    }
+
+    if (overlapping) {
+        for (size_t i = 0; i < obj->textCount; i++) {
+            obj->textRecords[i].modified = 1;
+        }
+    }
+    else {
+        for (size_t i = 0; i < obj->modCount; i++) {
+            const modRecord *m = &obj->modRecords[i];
+            uint64_t fieldStart = m->address;
+            uint64_t fieldEnd = fieldStart + (uint64_t)((m->lengthNibbles + 1) / 2);
+
+            // Find the last record starting before the end of the field
+            size_t lo = 0, hi = obj->textCount;
+            while (lo < hi) {
+                size_t mid = lo + (hi - lo) / 2;
+                if (sorted[mid]->address < fieldEnd) {
+                    lo = mid + 1;
+                }
+                else {
+                    hi = mid;
+                }
+            }
+
+            // Walk back while some earlier record still reaches the field
+            while (lo > 0 && maxEnd[lo - 1] > fieldStart) {
+                textRecord *t = sorted[--lo];
+                if ((uint64_t)t->address + t->length > fieldStart) {
+                    t->modified = 1;
+                }
+            }
+        }
+    }
+
+    if (sorted != sortedInline) {
+        free(sorted);
+        free(maxEnd);
+    }
+    return 0;
+}
+
+void objFree(objFile *file) {
+    if (!file) {
+        return;
+    }
+
+    // free records arrays and the source text they point into
+    free(file->textRecords);
+    free(file->modRecords);
+    if (file->source) {
+        releaseSource(file->source, file->sourceLength, file->sourceMapped);
+    }
 
     // Reset pointers and counts
     file->textRecords = NULL;
     file->modRecords  = NULL;
     file->textCount   = 0;
     file->modCount    = 0;
+    file->source       = NULL;
+    file->sourceLength = 0;
+    file->sourceMapped = 0;
 
     //clear header and endRecord
     memset(&file->header,    0, sizeof(file->header));
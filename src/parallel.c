@@ -0,0 +1,150 @@
+#include "parallel.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/**
+ * Implementation of the threading helpers declared in parallel.h.
+ *
+ * This file implements:
+ *   - parallelFor(): starts up to 'jobs' threads which repeatedly claim
+ *     the next index with an atomic increment and run the task on it.
+ *     The calling thread works too, and the call returns once every
+ *     index has been processed.
+ *   - defaultJobCount(): sysconf(_SC_NPROCESSORS_ONLN), at least 1
+ *   - The boundedQueue operations, a mutex plus two condition variables
+ *     around a ring of pointers. Closing the queue wakes every waiter;
+ *     consumers still drain what is left before queuePop() returns NULL.
+ */
+
+typedef struct {
+    atomic_size_t next; // Next index to hand out
+    size_t count; // Number of indices
+    parallelTask task; // Work for one index
+    void *ctx; // Caller context passed to task
+} parallelJob;
+
+static void *parallelWorker(void *arg) {
+    parallelJob *job = (parallelJob *)arg;
+
+    for (;;) {
+        size_t i = atomic_fetch_add(&job->next, 1);
+        if (i >= job->count) {
+            break;
+        }
+        job->task(i, job->ctx);
+    }
+    return NULL;
+}
+
+void parallelFor(size_t count, unsigned int jobs, parallelTask task, void *ctx) {
+    parallelJob job;
+    atomic_init(&job.next, 0);
+    job.count = count;
+    job.task = task;
+    job.ctx = ctx;
+
+    if (jobs > count) {
+        jobs = (unsigned int)count;
+    }
+
+    pthread_t *threads = NULL;
+    unsigned int started = 0;
+    if (jobs > 1) {
+        threads = (pthread_t *)malloc((jobs - 1) * sizeof(*threads));
+    }
+    if (threads) {
+        // The calling thread is the last worker
+        for (; started < jobs - 1; started++) {
+            if (pthread_create(&threads[started], NULL, parallelWorker, &job) != 0) {
+                break;
+            }
+        }
+    }
+
+    parallelWorker(&job);
+
+    for (unsigned int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+}
+
+unsigned int defaultJobCount(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return (n > 0) ? (unsigned int)n : 1U;
+}
+
+int queueInit(boundedQueue *q, size_t capacity) {
+    if (!q || capacity == 0) {
+        return -1;
+    }
+
+    q->items = (void **)malloc(capacity * sizeof(*q->items));
+    if (!q->items) {
+        return -1;
+    }
+    q->capacity = capacity;
+    q->head = 0;
+    q->count = 0;
+    q->closed = 0;
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->notEmpty, NULL);
+    pthread_cond_init(&q->notFull, NULL);
+    return 0;
+}
+
+void queueDestroy(boundedQueue *q) {
+    if (!q || !q->items) {
+        return;
+    }
+    pthread_mutex_destroy(&q->lock);
+    pthread_cond_destroy(&q->notEmpty);
+    pthread_cond_destroy(&q->notFull);
+    free(q->items);
+    q->items = NULL;
+}
+
+int queuePush(boundedQueue *q, void *item) {
+    pthread_mutex_lock(&q->lock);
+    while (q->count == q->capacity && !q->closed) {
+        pthread_cond_wait(&q->notFull, &q->lock);
+    }
+    if (q->closed) {
+        pthread_mutex_unlock(&q->lock);
+        return -1;
+    }
+
+    q->items[(q->head + q->count) % q->capacity] = item;
+    q->count++;
+    pthread_cond_signal(&q->notEmpty);
+    pthread_mutex_unlock(&q->lock);
+    return 0;
+}
+
+void *queuePop(boundedQueue *q) {
+    void *item = NULL;
+
+    pthread_mutex_lock(&q->lock);
+    while (q->count == 0 && !q->closed) {
+        pthread_cond_wait(&q->notEmpty, &q->lock);
+    }
+    if (q->count > 0) {
+        item = q->items[q->head];
+        q->head = (q->head + 1) % q->capacity;
+        q->count--;
+        pthread_cond_signal(&q->notFull);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return item;
+}
+
+void queueClose(boundedQueue *q) {
+    pthread_mutex_lock(&q->lock);
+    q->closed = 1;
+    pthread_cond_broadcast(&q->notEmpty);
+    pthread_cond_broadcast(&q->notFull);
+    pthread_mutex_unlock(&q->lock);
+}
@@ -0,0 +1,223 @@
+#include "placement.h"
+#include "loader.h"
+#include "memory.h"
+#include "objFile.h"
+#include "sic.h"
+#include "sicxe.h"
+#include "util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Implementation of multi-program placement.
+ *
+ * This file implements:
+ *   - placePrograms(): keeps a sorted list of free intervals. Programs
+ *     are placed largest first; each one goes into the free interval
+ *     that leaves the least space over once the start is aligned
+ *     (best fit), and that interval is split around it.
+ *   - runPlacement(): reads every object file, sizes each program from
+ *     its H record (and its T records when those reach further), places
+ *     them in the machine's address space, relocates them all into one
+ *     memory image without clearing it in between, then prints each
+ *     program's T and E records in input order and writes a load map.
+ */
+
+// Free interval [start, end) of the address space
+typedef struct {
+    uint64_t start;
+    uint64_t end;
+} freeBlock;
+
+// Program to place, in the order placePrograms() handles them
+typedef struct {
+    uint32_t length;
+    size_t index; // Position in the input
+} placeOrder;
+
+// Longest program first; ties keep input order
+static int compareByLength(const void *a, const void *b) {
+    const placeOrder *pa = (const placeOrder *)a;
+    const placeOrder *pb = (const placeOrder *)b;
+
+    if (pa->length != pb->length) {
+        return (pa->length > pb->length) ? -1 : 1;
+    }
+    return (pa->index < pb->index) ? -1 : (pa->index > pb->index);
+}
+
+static uint64_t alignUp(uint64_t value, uint32_t align) {
+    return ((value + align - 1) / align) * align;
+}
+
+int placePrograms(const uint32_t *lengths, size_t count, uint32_t base,
+                  uint32_t limit, uint32_t align, uint32_t *starts) {
+    if ((!lengths || !starts) && count > 0) {
+        return -1;
+    }
+    if (align == 0 || base > limit) {
+        return -1;
+    }
+
+    placeOrder *order = (placeOrder *)malloc((count + 1) * sizeof(*order));
+    freeBlock *blocks = (freeBlock *)malloc((count + 1) * 2 * sizeof(*blocks));
+    if (!order || !blocks) {
+        free(order);
+        free(blocks);
+        return -1;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        order[i].length = lengths[i];
+        order[i].index = i;
+    }
+    qsort(order, count, sizeof(*order), compareByLength);
+
+    size_t blockCount = 1;
+    blocks[0].start = base;
+    blocks[0].end = limit;
+
+    int result = 0;
+    for (size_t k = 0; k < count && result == 0; k++) {
+        size_t p = order[k].index;
+        size_t best = blockCount;
+        uint64_t bestStart = 0, bestWaste = 0;
+
+        for (size_t b = 0; b < blockCount; b++) {
+            uint64_t start = alignUp(blocks[b].start, align);
+            if (start > blocks[b].end || blocks[b].end - start < lengths[p]) {
+                continue;
+            }
+            // Measured from the aligned start: the padding before it is not usable
+            uint64_t waste = blocks[b].end - start - lengths[p];
+            if (best == blockCount || waste < bestWaste) {
+                best = b;
+                bestStart = start;
+                bestWaste = waste;
+            }
+        }
+
+        if (best == blockCount) {
+            result = -1;
+            break;
+        }
+
+        starts[p] = (uint32_t)bestStart;
+
+        // Split the chosen block into the space before and after the program
+        freeBlock before = { blocks[best].start, bestStart };
+        freeBlock after = { bestStart + lengths[p], blocks[best].end };
+        size_t pieces = 0;
+        freeBlock parts[2];
+        if (before.end > before.start) {
+            parts[pieces++] = before;
+        }
+        if (after.end > after.start) {
+            parts[pieces++] = after;
+        }
+
+        memmove(&blocks[best + pieces], &blocks[best + 1],
+                (blockCount - best - 1) * sizeof(*blocks));
+        for (size_t i = 0; i < pieces; i++) {
+            blocks[best + i] = parts[i];
+        }
+        blockCount = blockCount - 1 + pieces;
+    }
+
+    free(order);
+    free(blocks);
+    return result;
+}
+
+// Bytes a program occupies from its start address
+static uint32_t programFootprint(const objFile *obj, const char *path) {
+    uint64_t end = (uint64_t)obj->header.startAddress + obj->header.programLength;
+    char msg[512];
+
+    for (size_t i = 0; i < obj->textCount; i++) {
+        const textRecord *t = &obj->textRecords[i];
+        if (t->address < obj->header.startAddress) {
+            snprintf(msg, sizeof(msg), "%s: text below the program start can not be placed.", path);
+            fatal(msg);
+        }
+        if ((uint64_t)t->address + t->length > end) {
+            end = (uint64_t)t->address + t->length;
+        }
+    }
+    return (uint32_t)(end - obj->header.startAddress);
+}
+
+int runPlacement(const char *const *paths, size_t count, machineType machine,
+                 uint32_t align, const char *mapPath) {
+    if (count == 0) {
+        fatal("No programs to place.");
+    }
+
+    objFile *objs = (objFile *)calloc(count, sizeof(*objs));
+    uint32_t *lengths = (uint32_t *)malloc(count * sizeof(*lengths));
+    uint32_t *starts = (uint32_t *)malloc(count * sizeof(*starts));
+    char msg[512];
+
+    if (!objs || !lengths || !starts) {
+        fatal("Out of memory.");
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (objParseFile(paths[i], &objs[i]) != 0) {
+            if (objParseMessage()) {
+                printf("Error: %s\n", objParseMessage());
+            }
+            snprintf(msg, sizeof(msg), "Failed to parse SCOFF file %s.", paths[i]);
+            fatal(msg);
+        }
+        lengths[i] = programFootprint(&objs[i], paths[i]);
+    }
+
+    // The shared image lives in memory[], so it also bounds the address space
+    uint32_t limit = (machine == MACHINE_SIC) ? SIC_MAX_MEMORY : SICXE_MAX_MEMORY;
+    if (limit > MEM_SIZE) {
+        limit = MEM_SIZE;
+    }
+
+    if (placePrograms(lengths, count, 0, limit, align, starts) != 0) {
+        fatal("Programs do not fit in the address space.");
+    }
+
+    // One image for every program: clear it once, then relocate each into it
+    memInit();
+    for (size_t i = 0; i < count; i++) {
+        relocateObject(&objs[i], starts[i], machine);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        printRelocatedRecords(&objs[i], stdout);
+    }
+
+    FILE *map = stderr;
+    if (mapPath) {
+        map = fopen(mapPath, "w");
+        if (!map) {
+            fatal("Could not write load map.");
+        }
+    }
+    fprintf(map, "Program Start  End    Length Entry  File\n");
+    for (size_t i = 0; i < count; i++) {
+        uint32_t end = lengths[i] ? starts[i] + lengths[i] - 1 : starts[i];
+        fprintf(map, "%-7s %06X %06X %06X %06X %s\n", objs[i].header.progName,
+                (unsigned int)starts[i], (unsigned int)end, (unsigned int)lengths[i],
+                (unsigned int)objs[i].endRecord.firstExecAddress, paths[i]);
+    }
+    if (map != stderr) {
+        fclose(map);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        objFree(&objs[i]);
+    }
+    free(objs);
+    free(lengths);
+    free(starts);
+    return 0;
+}
@@ -0,0 +1,482 @@
+#include "refLoader.h"
+#include "memory.h"
+#include "sic.h"
+#include "sicxe.h"
+#include "util.h"
+
+/**
+ * Reference implementation of the loader, used by the --verify and --fuzz
+ * harness in verify.c.
+ *
+ * This file implements:
+ *   - refParseBuffer(), the original line-by-line parser: reads each line
+ *     the way fgets() would, parses H/T/M/E records, decodes every T
+ *     payload into bytes[] and does the same record order, length, hex
+ *     and range checks as objFileParser.c. The layout rules (no overlapping
+ *     T records, every M field inside loaded text) are checked with plain
+ *     nested loops instead of a sorted sweep.
+ *   - refRelocate(), the original relocator: writes every text byte into a
+ *     private memory image with memory.c's bounds checks, applies each M
+ *     record one byte at a time and reads every record back. The address
+ *     model checks of addrModel.c are done the direct way: the program
+ *     span with plain comparisons, and every field's net change after all
+ *     M records are applied, finding the other M records of a field with
+ *     a nested loop.
+ *   - refPrintRecords(), which prints every relocated byte with fprintf()
+ *
+ * Nothing here is meant to be fast. It is the specification the optimized
+ * modules are compared against, so keep it simple enough to check by eye.
+ */
+
+static uint8_t refMemory[MEM_SIZE]; // Private image, independent of memory.c
+
+static void refWriteByte(uint32_t addr, uint8_t value) {
+    if (addr >= MEM_SIZE) {
+        fatal("Memory write out of range");
+    }
+    refMemory[addr] = value;
+}
+
+static uint8_t refReadByte(uint32_t addr) {
+    if (addr >= MEM_SIZE) {
+        fatal("Memory read out of range");
+    }
+    return refMemory[addr];
+}
+
+// Copy the next line of src into line the way fgets() would. Returns the
+// number of source bytes consumed (0 at end of input).
+static size_t refReadLine(const char *src, size_t remaining, char *line, size_t size) {
+    size_t n = 0;
+
+    while (n < remaining && n + 1 < size) {
+        line[n] = src[n];
+        n++;
+        if (src[n - 1] == '\n') {
+            break;
+        }
+    }
+    line[n] = '\0';
+    return n;
+}
+
+// Remove trailing whitespace characters (including newlines)
+static void refTrim(char *s) {
+    size_t len = strlen(s);
+
+    while (len > 0 && isspace((unsigned char)s[len - 1])) {
+        s[--len] = '\0';
+    }
+}
+
+// Parse exactly 'len' hex characters at p into a uint32_t. Returns 1 on success, 0 on failure.
+static int refFixedHex(const char *p, size_t len, uint32_t *out) {
+    char buf[16];
+    char *end;
+    unsigned long val;
+
+    if (len == 0 || len >= sizeof(buf)) {
+        return 0;
+    }
+
+    memcpy(buf, p, len);
+    buf[len] = '\0';
+
+    val = strtoul(buf, &end, 16);
+    if (end != buf + len || val > 0xFFFFFFFFUL) {
+        return 0;
+    }
+
+    *out = (uint32_t)val;
+    return 1;
+}
+
+// Value of one payload hex digit (0-9, A-F, a-f only), or -1
+static int refHexDigit(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+// 1 if some T record of obj loads the byte at addr
+static int refCovered(const objFile *obj, uint64_t addr) {
+    for (size_t i = 0; i < obj->textCount; i++) {
+        const textRecord *t = &obj->textRecords[i];
+        if (addr >= t->address && addr < (uint64_t)t->address + t->length) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// No two T records may share a byte, and every byte of every M field must be loaded
+static int refLayoutOk(const objFile *obj) {
+    for (size_t i = 0; i < obj->textCount; i++) {
+        const textRecord *a = &obj->textRecords[i];
+        for (size_t j = i + 1; j < obj->textCount; j++) {
+            const textRecord *b = &obj->textRecords[j];
+            if (a->length > 0 && b->length > 0 &&
+                a->address < (uint64_t)b->address + b->length &&
+                b->address < (uint64_t)a->address + a->length) {
+                return 0;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < obj->modCount; i++) {
+        const modRecord *m = &obj->modRecords[i];
+        uint32_t byteCount = (m->lengthNibbles + 1U) / 2U;
+        for (uint32_t b = 0; b < byteCount; b++) {
+            if (!refCovered(obj, (uint64_t)m->address + b)) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+int refParseBuffer(const char *data, size_t length, objFile *out) {
+    char line[256];
+    size_t pos = 0;
+    size_t tCapacity = 0, mCapacity = 0;
+    int seenH = 0, seenE = 0;
+    uint32_t progStart = 0, headerLen = 0;
+    uint32_t lineNum = 0;
+    int error = 0;
+
+    if ((!data && length > 0) || !out) {
+        return -1;
+    }
+    memset(out, 0, sizeof(*out));
+
+    while (!error && pos < length) {
+        pos += refReadLine(data + pos, length - pos, line, sizeof(line));
+        lineNum++;
+        refTrim(line);
+
+        const char *p = line;
+        while (isspace((unsigned char)*p)) {
+            p++;
+        }
+        if (*p == '\0') {
+            continue; // blank line
+        }
+
+        char recType = line[0];
+        const char *fields = line + 1;
+        while (*fields == ' ' || *fields == '\t') {
+            ++fields;
+        }
+        uint32_t progEnd = progStart + headerLen;
+
+        if (recType == 'H') {
+            if (seenH || out->textCount > 0 || out->modCount > 0 || seenE) {
+                error = 1;
+                break;
+            }
+
+            const char *q = fields;
+            size_t nameLen = 0;
+            memset(&out->header, 0, sizeof(out->header));
+            while (*q && !isspace((unsigned char)*q) && nameLen < 6) {
+                out->header.progName[nameLen++] = *q++;
+            }
+            while (isspace((unsigned char)*q)) {
+                q++;
+            }
+            if (strlen(q) < 6 || !refFixedHex(q, 6, &progStart)) {
+                error = 1;
+                break;
+            }
+            q += 6;
+            while (isspace((unsigned char)*q)) {
+                q++;
+            }
+            if (strlen(q) < 6 || !refFixedHex(q, 6, &headerLen)) {
+                error = 1;
+                break;
+            }
+            out->header.startAddress = progStart;
+            out->header.programLength = headerLen;
+            seenH = 1;
+        }
+        else if (recType == 'T') {
+            uint32_t addr = 0, tLen = 0;
+            if (!seenH || seenE || strlen(fields) < 8 ||
+                !refFixedHex(fields, 6, &addr) || !refFixedHex(fields + 6, 2, &tLen) ||
+                tLen > MAX_T_BYTES || strlen(fields + 8) != (size_t)tLen * 2U) {
+                error = 1;
+                break;
+            }
+            if (headerLen > 0 && (addr < progStart || addr + tLen > progEnd)) {
+                error = 1;
+                break;
+            }
+
+            if (out->textCount == tCapacity) {
+                tCapacity = tCapacity ? tCapacity * 2 : 8;
+                textRecord *temp = (textRecord *)realloc(out->textRecords, tCapacity * sizeof(*temp));
+                if (!temp) {
+                    error = 1;
+                    break;
+                }
+                out->textRecords = temp;
+            }
+
+            textRecord *t = &out->textRecords[out->textCount];
+            memset(t, 0, sizeof(*t));
+            t->address = addr;
+            t->length = tLen;
+            t->decoded = 1;
+            for (uint32_t i = 0; i < tLen; i++) {
+                int hi = refHexDigit(fields[8 + i * 2]);
+                int lo = refHexDigit(fields[8 + i * 2 + 1]);
+                if (hi < 0 || lo < 0) {
+                    error = 1;
+                    break;
+                }
+                t->bytes[i] = (uint8_t)(hi * 16 + lo);
+            }
+            if (error) {
+                break;
+            }
+            out->textCount++;
+        }
+        else if (recType == 'M') {
+            uint32_t mAddr = 0, nibbles = 0;
+            if (!seenH || seenE || strlen(fields) < 9 ||
+                !refFixedHex(fields, 6, &mAddr) || !refFixedHex(fields + 6, 2, &nibbles) ||
+                (fields[8] != '+' && fields[8] != '-') || nibbles == 0) {
+                error = 1;
+                break;
+            }
+            if (headerLen > 0 && (mAddr < progStart || mAddr >= progEnd)) {
+                error = 1;
+                break;
+            }
+
+            if (out->modCount == mCapacity) {
+                mCapacity = mCapacity ? mCapacity * 2 : 8;
+                modRecord *temp = (modRecord *)realloc(out->modRecords, mCapacity * sizeof(*temp));
+                if (!temp) {
+                    error = 1;
+                    break;
+                }
+                out->modRecords = temp;
+            }
+
+            modRecord *m = &out->modRecords[out->modCount++];
+            memset(m, 0, sizeof(*m));
+            m->address = mAddr;
+            m->lengthNibbles = (uint8_t)nibbles;
+            m->sign = fields[8];
+            m->line = lineNum;
+        }
+        else if (recType == 'E') {
+            uint32_t execAddr = 0;
+            if (!seenH || seenE || strlen(fields) < 6 || !refFixedHex(fields, 6, &execAddr)) {
+                error = 1;
+                break;
+            }
+            if (headerLen > 0 && (execAddr < progStart || execAddr >= progEnd)) {
+                error = 1;
+                break;
+            }
+            out->endRecord.firstExecAddress = execAddr;
+            seenE = 1;
+        }
+        else {
+            error = 1;
+        }
+    }
+
+    if (!error && (!seenH || !seenE)) {
+        error = 1;
+    }
+    if (!error && !refLayoutOk(out)) {
+        error = 1;
+    }
+
+    if (error) {
+        objFree(out);
+        return -1;
+    }
+    return 0;
+}
+
+// Fatal error if the relocated program leaves the 2^bits address space
+static void refCheckProgram(const objFile *obj, int32_t R, unsigned int bits,
+                            const char *name, const char *who) {
+    int64_t limit = (int64_t)1 << bits;
+    int inside = 1;
+
+    int64_t start = (int64_t)obj->header.startAddress + R;
+    int64_t end = start + obj->header.programLength;
+    if (start < 0 || end > limit) {
+        inside = 0;
+    }
+    for (size_t i = 0; i < obj->textCount; i++) {
+        int64_t tStart = (int64_t)obj->textRecords[i].address + R;
+        int64_t tEnd = tStart + obj->textRecords[i].length;
+        if (tStart < 0 || tEnd > limit) {
+            inside = 0;
+        }
+    }
+    int64_t entry = (int64_t)obj->endRecord.firstExecAddress + R;
+    if (entry < 0 || entry >= limit) {
+        inside = 0;
+    }
+
+    if (!inside) {
+        static _Thread_local char msg[160]; // fatalMessage() keeps pointing here
+        snprintf(msg, sizeof(msg),
+                 "%s: relocation by %c%06X puts the program outside the %u-bit %s address space",
+                 who, (R < 0) ? '-' : '+', (unsigned int)((R < 0) ? -(int64_t)R : R), bits, name);
+        fatal(msg);
+    }
+}
+
+void refRelocate(objFile *obj, uint32_t reloc, machineType machine) {
+    const char *badLength = (machine == MACHINE_SIC)
+        ? "relocateSic: modification length exceeds 32 bits"
+        : "relocateSicXE: modification length exceeds 32 bits";
+    const char *badSign = (machine == MACHINE_SIC)
+        ? "relocateSic: invalid sign in modification record (expected '+' or '-')"
+        : "relocateSicXE: invalid sign in modification record (expected '+' or '-')";
+
+    const char *who = (machine == MACHINE_SIC) ? "relocateSic" : "relocateSicXE";
+    const char *name = (machine == MACHINE_SIC) ? "SIC" : "SIC/XE";
+    unsigned int addrBits = (machine == MACHINE_SIC) ? SIC_ADDR_BITS : SICXE_ADDR_BITS;
+
+    uint32_t oldStart = obj->header.startAddress;
+    int32_t R = (int32_t)reloc - (int32_t)oldStart;
+
+    refCheckProgram(obj, R, addrBits, name, who);
+
+    memset(refMemory, 0, sizeof(refMemory));
+
+    for (size_t i = 0; i < obj->textCount; i++) {
+        textRecord *t = &obj->textRecords[i];
+        uint32_t loadAddress = t->address + (uint32_t)R;
+
+        for (uint32_t j = 0; j < t->length; j++) {
+            refWriteByte(loadAddress + j, t->bytes[j]);
+        }
+    }
+
+    // Value of each M field just before its record is applied
+    uint32_t *before = (uint32_t *)malloc((obj->modCount ? obj->modCount : 1) * sizeof(*before));
+    if (!before) {
+        fatal("Out of memory.");
+    }
+
+    for (size_t i = 0; i < obj->modCount; i++) {
+        modRecord *m = &obj->modRecords[i];
+
+        uint8_t byteCount = (uint8_t)((m->lengthNibbles + 1) / 2);
+        uint8_t bits = (uint8_t)(m->lengthNibbles * 4U);
+
+        if (m->lengthNibbles > 8) {
+            free(before);
+            fatal(badLength);
+        }
+
+        uint32_t mask = (bits == 32) ? 0xFFFFFFFFU : ((1U << bits) - 1U);
+        uint32_t targetAddr = m->address + (uint32_t)R;
+        uint32_t aggregate = 0;
+
+        for (uint8_t b = 0; b < byteCount; ++b) {
+            aggregate = (aggregate << 8) | refReadByte(targetAddr + b);
+        }
+
+        uint32_t field = aggregate & mask; // Right-aligned in its bytes
+        before[i] = field;
+
+        if (m->sign == '+') {
+            field += (uint32_t)R;
+        }
+        else if (m->sign == '-') {
+            field -= (uint32_t)R;
+        }
+        else {
+            free(before);
+            fatal(badSign);
+        }
+        field &= mask;
+
+        uint32_t newValue = (aggregate & ~mask) | field;
+
+        for (int b = (int)byteCount - 1; b >= 0; --b) {
+            refWriteByte(targetAddr + (uint32_t)b, (uint8_t)(newValue & 0xFFU));
+            newValue >>= 8;
+        }
+    }
+
+    // Each field, judged at its first M record, must end inside the address space
+    for (size_t i = 0; i < obj->modCount; i++) {
+        const modRecord *m = &obj->modRecords[i];
+        int firstOfField = 1;
+        int64_t net = 0;
+
+        for (size_t j = 0; j < obj->modCount; j++) {
+            const modRecord *other = &obj->modRecords[j];
+            if (other->address != m->address || other->lengthNibbles != m->lengthNibbles) {
+                continue;
+            }
+            if (j < i) {
+                firstOfField = 0;
+            }
+            net += (other->sign == '-') ? -1 : 1;
+        }
+        if (!firstOfField) {
+            continue;
+        }
+
+        unsigned int fieldBits = m->lengthNibbles * 4U;
+        unsigned int limit = (fieldBits < addrBits) ? fieldBits : addrBits;
+        uint64_t value = (uint64_t)((int64_t)before[i] + net * (int64_t)R);
+        if (((value ^ before[i]) >> limit) != 0) {
+            static _Thread_local char msg[160]; // fatalMessage() keeps pointing here
+            snprintf(msg, sizeof(msg), "%s: line %u: M record field at %06X leaves the %u-bit %s address space",
+                     who, (unsigned int)m->line, (unsigned int)((m->address + (uint32_t)R) & 0xFFFFFFU),
+                     addrBits, name);
+            free(before);
+            fatal(msg);
+        }
+    }
+    free(before);
+
+    for (size_t i = 0; i < obj->textCount; i++) {
+        textRecord *t = &obj->textRecords[i];
+        uint32_t loadAddress = t->address + (uint32_t)R;
+
+        for (uint32_t j = 0; j < t->length; j++) {
+            t->bytes[j] = refReadByte(loadAddress + j);
+        }
+        t->address = loadAddress;
+    }
+
+    obj->relocFactor = R;
+    obj->header.startAddress = reloc;
+    obj->endRecord.firstExecAddress = (obj->endRecord.firstExecAddress + (uint32_t)R) & 0xFFFFFFu;
+}
+
+void refPrintRecords(const objFile *obj, FILE *out) {
+    for (size_t i = 0; i < obj->textCount; i++) {
+        const textRecord *t = &obj->textRecords[i];
+
+        fprintf(out, "T%06X%02X", (unsigned int)t->address, (unsigned int)t->length);
+        for (uint32_t j = 0; j < t->length; j++) {
+            fprintf(out, "%02X", (unsigned int)t->bytes[j]);
+        }
+        fprintf(out, "\n");
+    }
+    fprintf(out, "E%06X\n", (unsigned int)obj->endRecord.firstExecAddress);
+}
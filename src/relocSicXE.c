@@ -1,6 +1,8 @@
 #include "relocSicXE.h"
+#include "addrModel.h"
 #include "memory.h"
 #include "objFile.h"
+#include "trace.h"
 #include "util.h"
 
 #include <stddef.h>
@@ -18,10 +20,15 @@
  *         fields in the text should be adjusted
  *       * Handles SIC/XE-specific field sizes and formats (e.g., 20-bit
  *         address fields in format 3/4 instructions, extended format)
- *   - Ensure that updated fields remain consistent with SIC/XE encoding
+ *   - Ensure that updated fields remain consistent with SIC/XE encoding,
+ *     and reject a relocation that moves the program or any relocated
+ *     field outside the 20-bit SIC/XE address space (addrModel.h)
+ *   - Decode and load only the text records that an M record touches;
+ *     the rest keep their original hex text and are only moved
  *
  * Like relocSic.c, this module assumes parsing is already done and
- * focuses solely on address adjustment for SIC/XE.
+ * focuses solely on address adjustment for SIC/XE. The caller prepares
+ * the simulated memory (memInit()).
  */
 
 
@@ -33,44 +40,75 @@ void relocateSicXE(objFile *obj, uint32_t reloc) {
     uint32_t oldStart = obj->header.startAddress;
     int32_t  R        = (int32_t)reloc - (int32_t)oldStart;
 
-    memInit();
+    // Reject relocations that move the program out of the address space
+    addrModelCheckProgram(&addrModelSicXE, obj, R, "relocateSicXE");
+
+    uint64_t spanStart = traceNow();
+    uint64_t spanBytes = 0;
+
+    // Only the records an M field lands in are decoded and loaded into memory
+    if (objMarkModifiedText(obj) != 0) {
+        fatal("relocateSicXE: out of memory while planning relocation");
+    }
 
     for (size_t i = 0; i < obj->textCount; i++) {
         textRecord *t = &obj->textRecords[i];
 
         uint32_t loadAddress = t->address + (uint32_t)R;
 
-        for (uint32_t j = 0; j < t->length; j++) {
-            uint32_t addr = loadAddress + j;
-            memWriteByte(addr, t->bytes[j]);
+        if (!t->modified) {
+            // Untouched records are just moved; still make sure they fit
+            if (t->length > 0 && (loadAddress >= MEM_SIZE || t->length > MEM_SIZE - loadAddress)) {
+                fatal("Memory write out of range");
+            }
+            continue;
+        }
+
+        if (objDecodeText(t) != 0) {
+            fatal("relocateSicXE: invalid hex digits in text record");
         }
+
+        memWriteBlock(loadAddress, t->bytes, t->length);
+        spanBytes += t->length;
+    }
+    traceSpan("plan", obj->header.progName, spanStart, spanBytes, obj->textCount);
+
+    spanStart = traceNow();
+    spanBytes = 0;
+
+    fixupLog log;
+    if (fixupLogInit(&log, obj->modCount) != 0) {
+        fatal("relocateSicXE: out of memory while planning relocation");
     }
 
     for (size_t i = 0; i < obj->modCount; i++) {
         modRecord *m = &obj->modRecords[i];
 
         if (m->lengthNibbles == 0) {
-            fatal("relocateSicXE: invalid modification length (must be > 0 nibbles)");
+            fixupLogFail(&log, "relocateSicXE: invalid modification length (must be > 0 nibbles)");
         }
 
-        uint8_t  byteCount = (uint8_t)((m->lengthNibbles + 1) / 2); // round up
-        uint8_t  unusedLow = (uint8_t)(byteCount * 2U - m->lengthNibbles); // 0 or 1
-        uint8_t  shift     = (uint8_t)(unusedLow * 4U);
-        uint8_t  bits      = (uint8_t)(m->lengthNibbles * 4U);
-
-        if (bits > 32) {
-            fatal("relocateSicXE: modification length exceeds 32 bits");
+        // Checked before any arithmetic on the width, which is up to 0xFF nibbles
+        if (m->lengthNibbles > 8) {
+            fixupLogFail(&log, "relocateSicXE: modification length exceeds 32 bits");
         }
 
+        uint8_t  byteCount = (uint8_t)((m->lengthNibbles + 1) / 2); // round up
+        unsigned int bits  = m->lengthNibbles * 4U;
+
         uint64_t mask64 = (bits == 32) ? 0xFFFFFFFFULL : ((1ULL << bits) - 1ULL);
         uint32_t targetAddr = m->address + (uint32_t)R;
-        uint32_t aggregate  = 0;
 
-        for (uint8_t b = 0; b < byteCount; ++b) {
-            aggregate = (aggregate << 8) | memReadByte(targetAddr + b);
+        // Same test and message as memReadField(), made here so the log is freed
+        if (targetAddr >= MEM_SIZE || byteCount > MEM_SIZE - targetAddr) {
+            fixupLogFail(&log, "Memory read out of range");
         }
+        uint32_t aggregate  = memReadField(targetAddr, byteCount);
 
-        uint32_t field = (uint32_t)((aggregate >> shift) & (uint32_t)mask64);
+        // The field is right-aligned in its bytes: an odd width starts at the
+        // low nibble of the first byte and leaves its high nibble alone
+        uint32_t field = aggregate & (uint32_t)mask64;
+        log.before[i] = field;
 
         if (m->sign == '+') {
             field += (uint32_t)R;
@@ -79,32 +117,36 @@ void relocateSicXE(objFile *obj, uint32_t reloc) {
             field -= (uint32_t)R;
         }
         else {
-            fatal("relocateSicXE: invalid sign in modification record (expected '+' or '-')");
+            fixupLogFail(&log, "relocateSicXE: invalid sign in modification record (expected '+' or '-')");
         }
 
+        log.after[i] = field;
+        log.limit[i] = (bits < addrModelSicXE.addrBits) ? bits : addrModelSicXE.addrBits;
         field &= (uint32_t)mask64;
 
-        uint32_t preservedLow = (shift == 0) ? 0U : (aggregate & ((1U << shift) - 1U));
-        uint32_t newValue = (field << shift) | preservedLow;
+        uint32_t newValue = (aggregate & ~(uint32_t)mask64) | field;
 
-        for (int b = (int)byteCount - 1; b >= 0; --b) {
-            uint8_t outByte = (uint8_t)(newValue & 0xFFU);
-            memWriteByte(targetAddr + (uint32_t)b, outByte);
-            newValue >>= 8;
-        }
+        memWriteField(targetAddr, newValue, byteCount);
+        spanBytes += byteCount;
     }
 
+    // Post-pass: every fixup must stay inside the address model
+    addrModelCheckFixups(&addrModelSicXE, &log, obj, R, "relocateSicXE");
+    fixupLogFree(&log);
+
     for (size_t i = 0; i < obj->textCount; i++) {
         textRecord *t = &obj->textRecords[i];
         uint32_t loadAddress = t->address + (uint32_t)R;
 
-        for (uint32_t j = 0; j < t->length; j++) {
-            t->bytes[j] = memReadByte(loadAddress + j);
+        if (t->modified) {
+            memReadBlock(loadAddress, t->bytes, t->length);
         }
 
         t->address = loadAddress;
     }
+    traceSpan("fixup", obj->header.progName, spanStart, spanBytes, obj->modCount);
 
+    obj->relocFactor               = R;
     obj->header.startAddress       = reloc;
     obj->endRecord.firstExecAddress = (obj->endRecord.firstExecAddress + (uint32_t)R) & 0xFFFFFFu;
 }
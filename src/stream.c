@@ -0,0 +1,315 @@
+#include "stream.h"
+#include "compress.h"
+#include "loader.h"
+#include "memory.h"
+#include "objFile.h"
+#include "parallel.h"
+#include "trace.h"
+#include "util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+/**
+ * Implementation of the streaming, pipelined loader mode.
+ *
+ * This file implements:
+ *   - streamReader(): reads the input line by line into a buffer per
+ *     program, hands each finished buffer to objParseBuffer() and gives
+ *     the buffer to the resulting objFile (its T records point into it)
+ *   - streamRelocator(): clears memory and relocates each program with
+ *     relocateObject(); it is the only stage touching the memory image
+ *   - runStream(): starts both threads and acts as the emitter
+ *
+ * A gzip or zstd compressed input file is read through the decompressor
+ * (compress.h), which runs alongside the three stages. Only regular files
+ * are sniffed for it: the magic bytes of a pipe could not be read again.
+ *
+ * Program k is relocated to its line k of the relocation file when one is
+ * given, otherwise to baseAddress + k * stride, or with no stride right
+ * after the H record length of program k - 1. A program that fails to
+ * parse or relocate is passed down the pipeline as an error item (the
+ * relocator traps fatal()), so every program before it is still printed
+ * before the loader stops.
+ */
+
+#define STREAM_QUEUE_DEPTH 4 // Programs buffered between two stages
+
+// One program travelling through the pipeline
+typedef struct {
+    objFile obj; // Parsed (then relocated) program
+    size_t index; // Position of the program in the stream
+    uint32_t reloc; // Relocation address of the program
+    char error[256]; // Non-empty when the program can not be loaded
+} streamItem;
+
+typedef struct {
+    const streamConfig *config;
+    FILE *input; // Object stream
+    compressStream decompressor; // Feeds input when the stream file is compressed
+    FILE *relocs; // Relocation side channel, or NULL
+    uint32_t packed; // Next free address when programs are packed (no stride)
+    boundedQueue parsed; // reader -> relocator
+    boundedQueue relocated; // relocator -> emitter
+} streamState;
+
+// Growable buffer holding the text of the program being read
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+} textBuffer;
+
+static int bufferAppend(textBuffer *b, const char *s, size_t n) {
+    if (b->length + n > b->capacity) {
+        size_t capacity = b->capacity ? b->capacity : 1024;
+        while (capacity < b->length + n) {
+            capacity *= 2;
+        }
+        char *temp = (char *)realloc(b->data, capacity);
+        if (!temp) {
+            return -1;
+        }
+        b->data = temp;
+        b->capacity = capacity;
+    }
+    memcpy(b->data + b->length, s, n);
+    b->length += n;
+    return 0;
+}
+
+// Relocation address of the parsed program 'index'. Returns 0 on success.
+static int nextRelocation(streamState *s, size_t index, const objFile *obj, uint32_t *reloc) {
+    if (!s->relocs && s->config->stride == 0) {
+        *reloc = s->packed;
+        s->packed += obj->header.programLength;
+        return 0;
+    }
+    if (!s->relocs) {
+        *reloc = s->config->baseAddress + (uint32_t)index * s->config->stride;
+        return 0;
+    }
+
+    char line[64];
+    while (fgets(line, sizeof(line), s->relocs) != NULL) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0') {
+            continue;
+        }
+        return parseHex(line, reloc) ? 0 : -1;
+    }
+    return -1;
+}
+
+// Parse the buffered program and send it to the relocator. Returns 0 while
+// the stream can go on.
+static int finishProgram(streamState *s, textBuffer *text, size_t index) {
+    streamItem *item = (streamItem *)calloc(1, sizeof(*item));
+    if (!item) {
+        return -1;
+    }
+    item->index = index;
+
+    uint64_t spanStart = traceNow();
+    if (objParseBuffer(text->data, text->length, &item->obj) != 0) {
+        if (objParseMessage()) {
+            snprintf(item->error, sizeof(item->error),
+                     "Failed to parse SCOFF program %zu of the stream: %s.", index + 1,
+                     objParseMessage());
+        }
+        else {
+            snprintf(item->error, sizeof(item->error),
+                     "Failed to parse SCOFF program %zu of the stream.", index + 1);
+        }
+    }
+    else if (nextRelocation(s, index, &item->obj, &item->reloc) != 0) {
+        snprintf(item->error, sizeof(item->error),
+                 "Missing or invalid relocation address for program %zu.", index + 1);
+    }
+    else {
+        // The T records point into the program text, so the objFile keeps it
+        item->obj.source = text->data;
+        item->obj.sourceLength = text->length;
+        item->obj.sourceMapped = 0;
+        text->data = NULL;
+        text->capacity = 0;
+        traceSpan("parse", item->obj.header.progName, spanStart, text->length,
+                  item->obj.textCount + item->obj.modCount);
+    }
+    text->length = 0;
+
+    int failed = item->error[0] != '\0';
+    if (queuePush(&s->parsed, item) != 0) {
+        objFree(&item->obj);
+        free(item);
+        return -1;
+    }
+    return failed ? -1 : 0;
+}
+
+static void *streamReader(void *arg) {
+    streamState *s = (streamState *)arg;
+    textBuffer text = {0};
+    char *line = NULL;
+    size_t lineCapacity = 0;
+    ssize_t n;
+    size_t programs = 0;
+    int seenE = 0; // The current program already has its E record
+    int content = 0; // The current program has a non-blank line
+
+    while ((n = getline(&line, &lineCapacity, s->input)) > 0) {
+        // An H record after an E record starts the next program
+        if (line[0] == 'H' && seenE) {
+            if (finishProgram(s, &text, programs++) != 0) {
+                content = 0;
+                break;
+            }
+            seenE = 0;
+            content = 0;
+        }
+        if (line[0] == 'E') {
+            seenE = 1;
+        }
+        if (strspn(line, " \t\r\n") != (size_t)n) {
+            content = 1;
+        }
+        if (bufferAppend(&text, line, (size_t)n) != 0) {
+            fatal("Out of memory.");
+        }
+    }
+
+    if (content) {
+        finishProgram(s, &text, programs);
+    }
+
+    free(line);
+    free(text.data);
+    queueClose(&s->parsed);
+    return NULL;
+}
+
+static void *streamRelocator(void *arg) {
+    streamState *s = (streamState *)arg;
+    streamItem *item;
+
+    while ((item = (streamItem *)queuePop(&s->parsed)) != NULL) {
+        if (item->error[0] == '\0') {
+            // A rejected relocation becomes an error item too, so the
+            // emitter stays the only thread that prints or exits
+            jmp_buf trap;
+            jmp_buf *previous = fatalSetTrap(&trap);
+            if (setjmp(trap) == 0) {
+                memInit();
+                relocateObject(&item->obj, item->reloc, s->config->machineType);
+            }
+            else {
+                snprintf(item->error, sizeof(item->error), "%s", fatalMessage());
+            }
+            fatalSetTrap(previous);
+        }
+        if (queuePush(&s->relocated, item) != 0) {
+            objFree(&item->obj);
+            free(item);
+        }
+    }
+
+    queueClose(&s->relocated);
+    return NULL;
+}
+
+int runStream(const streamConfig *config) {
+    streamState s;
+    pthread_t reader, relocator;
+
+    memset(&s, 0, sizeof(s));
+    s.config = config;
+    s.packed = config->baseAddress;
+
+    if (strcmp(config->inputPath, "-") == 0) {
+        s.input = stdin;
+    }
+    else if ((s.input = fopen(config->inputPath, "rb")) == NULL) {
+        fatal("Could not open object stream.");
+    }
+    else {
+        struct stat st;
+        if (fstat(fileno(s.input), &st) == 0 && S_ISREG(st.st_mode)) {
+            uint8_t magic[COMPRESS_MAGIC_BYTES];
+            compressFormat format = compressDetect(magic, fread(magic, 1, sizeof(magic), s.input));
+            if (format != COMPRESS_NONE) {
+                fclose(s.input);
+                if (compressOpenRead(config->inputPath, format, &s.decompressor) != 0) {
+                    fatal("Could not start the decompressor for the object stream.");
+                }
+                s.input = s.decompressor.fp;
+            }
+            else if (fseek(s.input, 0, SEEK_SET) != 0) {
+                fatal("Could not rewind the object stream.");
+            }
+        }
+    }
+    if (config->relocsPath && (s.relocs = fopen(config->relocsPath, "r")) == NULL) {
+        fatal("Could not open relocation address file.");
+    }
+
+    if (queueInit(&s.parsed, STREAM_QUEUE_DEPTH) != 0 ||
+        queueInit(&s.relocated, STREAM_QUEUE_DEPTH) != 0) {
+        fatal("Out of memory.");
+    }
+    if (pthread_create(&reader, NULL, streamReader, &s) != 0 ||
+        pthread_create(&relocator, NULL, streamRelocator, &s) != 0) {
+        fatal("Could not start the stream pipeline.");
+    }
+
+    // Emitter stage
+    streamItem *item;
+    while ((item = (streamItem *)queuePop(&s.relocated)) != NULL) {
+        if (item->error[0] != '\0') {
+            // Stop both stages before exiting: once the queues are closed
+            // their pushes fail, so the threads free what they hold and return
+            queueClose(&s.parsed);
+            queueClose(&s.relocated);
+            pthread_join(reader, NULL);
+            pthread_join(relocator, NULL);
+            streamItem *rest;
+            while ((rest = (streamItem *)queuePop(&s.relocated)) != NULL) {
+                objFree(&rest->obj);
+                free(rest);
+            }
+            fflush(stdout);
+            fatal(item->error);
+        }
+
+        uint64_t spanStart = traceNow();
+        if (config->outputMode == OUTPUT_DELTA) {
+            printDeltaRecords(&item->obj, stdout);
+        }
+        else {
+            printRelocatedRecords(&item->obj, stdout);
+        }
+        traceSpan("emit", item->obj.header.progName, spanStart, 0, item->obj.textCount + 1);
+
+        objFree(&item->obj);
+        free(item);
+    }
+
+    pthread_join(reader, NULL);
+    pthread_join(relocator, NULL);
+    queueDestroy(&s.parsed);
+    queueDestroy(&s.relocated);
+
+    if (s.decompressor.fp) {
+        if (compressClose(&s.decompressor) != 0) {
+            fatal("Could not decompress the object stream.");
+        }
+    }
+    else if (s.input != stdin) {
+        fclose(s.input);
+    }
+    if (s.relocs) {
+        fclose(s.relocs);
+    }
+    return 0;
+}
@@ -0,0 +1,175 @@
+#include "trace.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * Implementation of the Chrome trace-event recorder.
+ *
+ * This file implements:
+ *   - A ring of traceEvent entries per thread, created on the thread's
+ *     first span and pushed onto a global list with a compare-and-swap
+ *   - traceSpan(), which only writes into the calling thread's ring and
+ *     publishes the new head with a release store
+ *   - An atexit() handler that walks every ring and writes the spans as
+ *     "complete" (ph = X) events with their byte and record counts
+ */
+
+#define TRACE_OBJECT_CHARS 64 // Object label stored per span (truncated)
+
+typedef struct {
+    const char *name; // Phase name (string literal)
+    char object[TRACE_OBJECT_CHARS]; // File or program the span worked on
+    uint64_t startUs; // Span start
+    uint64_t durationUs; // Span length
+    uint64_t bytes; // Bytes handled by the span
+    uint64_t records; // Records handled by the span
+} traceEvent;
+
+typedef struct traceRing {
+    struct traceRing *next; // Next ring in the global list
+    uint32_t threadId; // Small sequential id used as the trace "tid"
+    atomic_ulong head; // Number of spans ever written to this ring
+    traceEvent events[TRACE_RING_SIZE];
+} traceRing;
+
+static char *tracePath = NULL; // Output file; NULL while tracing is off
+static _Atomic(traceRing *) ringList = NULL; // Every ring created so far
+static atomic_uint nextThreadId = 1;
+static _Thread_local traceRing *localRing = NULL;
+
+static traceRing *threadRing(void) {
+    if (localRing) {
+        return localRing;
+    }
+
+    traceRing *ring = (traceRing *)calloc(1, sizeof(*ring));
+    if (!ring) {
+        return NULL;
+    }
+    ring->threadId = atomic_fetch_add(&nextThreadId, 1);
+    atomic_init(&ring->head, 0);
+
+    // Lock-free push onto the global list
+    traceRing *head = atomic_load(&ringList);
+    do {
+        ring->next = head;
+    } while (!atomic_compare_exchange_weak(&ringList, &head, ring));
+
+    localRing = ring;
+    return ring;
+}
+
+// Write s as a JSON string literal
+static void writeJsonString(FILE *fp, const char *s) {
+    fputc('"', fp);
+    for (; *s; ++s) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') {
+            fputc('\\', fp);
+            fputc(c, fp);
+        }
+        else if (c < 0x20) {
+            fprintf(fp, "\\u%04x", c);
+        }
+        else {
+            fputc(c, fp);
+        }
+    }
+    fputc('"', fp);
+}
+
+static void traceDump(void) {
+    FILE *fp = fopen(tracePath, "w");
+    if (!fp) {
+        fprintf(stderr, "Error: Could not write trace file %s\n", tracePath);
+        return;
+    }
+
+    int first = 1;
+    fprintf(fp, "{\"traceEvents\":[\n");
+    for (traceRing *ring = atomic_load(&ringList); ring; ring = ring->next) {
+        unsigned long head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        unsigned long begin = (head > TRACE_RING_SIZE) ? head - TRACE_RING_SIZE : 0;
+
+        fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+                "\"args\":{\"name\":\"thread %u\"}}", first ? "" : ",\n",
+                (unsigned int)ring->threadId, (unsigned int)ring->threadId);
+        first = 0;
+
+        for (unsigned long i = begin; i < head; i++) {
+            const traceEvent *ev = &ring->events[i % TRACE_RING_SIZE];
+            fprintf(fp, ",\n{\"name\":\"%s\",\"cat\":\"loader\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                    "\"ts\":%llu,\"dur\":%llu,\"args\":{\"object\":",
+                    ev->name, (unsigned int)ring->threadId,
+                    (unsigned long long)ev->startUs, (unsigned long long)ev->durationUs);
+            writeJsonString(fp, ev->object);
+            fprintf(fp, ",\"bytes\":%llu,\"records\":%llu}}",
+                    (unsigned long long)ev->bytes, (unsigned long long)ev->records);
+        }
+    }
+    fprintf(fp, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    fclose(fp);
+}
+
+int traceOpen(const char *path) {
+    if (!path || *path == '\0' || tracePath) {
+        return -1;
+    }
+
+    tracePath = (char *)malloc(strlen(path) + 1);
+    if (!tracePath) {
+        return -1;
+    }
+    strcpy(tracePath, path);
+
+    if (atexit(traceDump) != 0) {
+        free(tracePath);
+        tracePath = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+int traceEnabled(void) {
+    return tracePath != NULL;
+}
+
+uint64_t traceNow(void) {
+    if (!tracePath) {
+        return 0;
+    }
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+void traceSpan(const char *name, const char *object, uint64_t startUs,
+               uint64_t bytes, uint64_t records) {
+    if (!tracePath) {
+        return;
+    }
+
+    traceRing *ring = threadRing();
+    if (!ring) {
+        return;
+    }
+
+    uint64_t now = traceNow();
+    unsigned long head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    traceEvent *ev = &ring->events[head % TRACE_RING_SIZE];
+
+    ev->name = name;
+    strncpy(ev->object, object ? object : "", sizeof(ev->object) - 1);
+    ev->object[sizeof(ev->object) - 1] = '\0';
+    ev->startUs = startUs;
+    ev->durationUs = (now > startUs) ? now - startUs : 0;
+    ev->bytes = bytes;
+    ev->records = records;
+
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
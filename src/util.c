@@ -12,7 +12,11 @@
  *   - Implement parseHex(), which converts a hex string into a
  *     uint32_t (optionally handling an optional 0x/0X prefix)
  *   - Implement fatal(), which prints an error message and
- *     terminates the program with a non-zero exit code
+ *     terminates the program with a non-zero exit code, unless the
+ *     calling thread installed a trap with fatalSetTrap(); then fatal()
+ *     keeps the message for fatalMessage() and longjmp()s to that trap
+ *     instead of printing and exiting
+ *   - Implement fatalPath(), fatal() with "what: path" as the message
  *
  * These helpers centralize common tasks so that main.c, loader.c,
  * parser, and relocation code can remain clean and focused on their
@@ -58,10 +62,45 @@ int parseHex (const char *s, uint32_t *out) {
     return 1;
 }
 
-void fatal(const char *msg) {
+static _Thread_local jmp_buf *fatalTrap = NULL; // Where fatal() jumps instead of exiting
+static _Thread_local const char *fatalLast = NULL; // Message of the last trapped fatal()
+
+_Noreturn void fatal(const char *msg) {
     if (msg == NULL) {
         msg = "fatal error";
     }
+    if (fatalTrap) {
+        fatalLast = msg;
+        longjmp(*fatalTrap, 1);
+    }
     printf("Error: %s\n", msg);
     exit(EXIT_FAILURE);
 }
+
+_Noreturn void fatalPath(const char *what, const char *path) {
+    // Kept per thread and sized to fit, so a trapped message stays readable
+    static _Thread_local char *msg = NULL;
+    static _Thread_local size_t capacity = 0;
+    size_t need = strlen(what) + strlen(path) + 3; // ": " and the terminator
+
+    if (need > capacity) {
+        char *temp = (char *)realloc(msg, need);
+        if (!temp) {
+            fatal(what);
+        }
+        msg = temp;
+        capacity = need;
+    }
+    snprintf(msg, capacity, "%s: %s", what, path);
+    fatal(msg);
+}
+
+jmp_buf *fatalSetTrap(jmp_buf *env) {
+    jmp_buf *previous = fatalTrap;
+    fatalTrap = env;
+    return previous;
+}
+
+const char *fatalMessage(void) {
+    return fatalLast;
+}
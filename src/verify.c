@@ -0,0 +1,517 @@
+#include "verify.h"
+#include "memory.h"
+#include "objFile.h"
+#include "refLoader.h"
+#include "util.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Implementation of the differential test harness.
+ *
+ * This file implements:
+ *   - runBoth(): one parse/relocate/print pass with either the optimized
+ *     modules (objParseBuffer(), relocateObject(), printRelocatedRecords())
+ *     or the reference ones in refLoader.c, capturing the printed text in
+ *     memory and the message of a trapped fatal()
+ *   - verifyParse() / verifyBuffer(), which compare the two sides
+ *   - runVerify(), which checks real object files at a fixed set of
+ *     relocation addresses (including ones below the program start, so
+ *     the relocation factor is negative) on both machines
+ *   - runFuzz(), a seeded generator of SCOFF programs: random T record
+ *     lengths and gaps (gap 0 lets an M field straddle two records),
+ *     random M widths (any two hex digits) and signs, lowercase payloads, CRLF line ends and
+ *     blank lines, plus random edits that turn most of them into
+ *     near-valid input the parser or relocator has to reject
+ *
+ * The generator uses its own xorshift state, so a run is reproducible
+ * from its seed on every platform.
+ */
+
+#define VERIFY_FUZZ_MAX_TEXT 12 // T records per generated program
+#define VERIFY_FUZZ_MAX_MODS 8 // M records per generated program
+
+// Outcome of one parse/relocate/print pass
+typedef enum {
+    RUN_OK = 0, // Relocated and printed
+    RUN_REJECTED = 1, // Rejected by the parser
+    RUN_FAILED = 2 // Rejected by the relocator (fatal())
+} runStatus;
+
+typedef struct {
+    runStatus status;
+    const char *message; // fatal() message when status is RUN_FAILED
+    char *text; // Printed T/E records when status is RUN_OK
+    size_t length;
+} runResult;
+
+static const char *statusName(runStatus status) {
+    switch (status) {
+    case RUN_OK:
+        return "relocated";
+    case RUN_REJECTED:
+        return "rejected by the parser";
+    default:
+        return "rejected by the relocator";
+    }
+}
+
+// Parse, relocate and print data with the reference (useReference) or optimized modules
+static void runBoth(const char *data, size_t length, uint32_t reloc, machineType machine,
+                    int useReference, runResult *r) {
+    objFile obj;
+    int parsed;
+
+    memset(r, 0, sizeof(*r));
+    parsed = useReference ? refParseBuffer(data, length, &obj)
+                          : objParseBuffer(data, length, &obj);
+    if (parsed != 0) {
+        r->status = RUN_REJECTED;
+        return;
+    }
+
+    jmp_buf trap;
+    jmp_buf *previous = fatalSetTrap(&trap);
+    if (setjmp(trap) == 0) {
+        if (useReference) {
+            refRelocate(&obj, reloc, machine);
+        }
+        else {
+            memInit();
+            relocateObject(&obj, reloc, machine);
+        }
+
+        FILE *mem = open_memstream(&r->text, &r->length);
+        if (!mem) {
+            fatal("Out of memory.");
+        }
+        if (useReference) {
+            refPrintRecords(&obj, mem);
+        }
+        else {
+            printRelocatedRecords(&obj, mem);
+        }
+        fclose(mem);
+        r->status = RUN_OK;
+    }
+    else {
+        r->status = RUN_FAILED;
+        r->message = fatalMessage();
+    }
+    fatalSetTrap(previous);
+    objFree(&obj);
+}
+
+// Print the first line where a and b differ
+static void reportFirstDifference(FILE *report, const char *a, size_t aLen,
+                                  const char *b, size_t bLen) {
+    size_t i = 0, lineStart = 0, line = 1;
+
+    while (i < aLen && i < bLen && a[i] == b[i]) {
+        if (a[i++] == '\n') {
+            lineStart = i;
+            line++;
+        }
+    }
+    const char *aEnd = memchr(a + lineStart, '\n', aLen - lineStart);
+    const char *bEnd = memchr(b + lineStart, '\n', bLen - lineStart);
+    int aShow = (int)((aEnd ? (size_t)(aEnd - a) : aLen) - lineStart);
+    int bShow = (int)((bEnd ? (size_t)(bEnd - b) : bLen) - lineStart);
+
+    fprintf(report, "  output line %zu differs:\n", line);
+    fprintf(report, "    reference: %.*s\n", aShow, a + lineStart);
+    fprintf(report, "    optimized: %.*s\n", bShow, b + lineStart);
+}
+
+int verifyParse(const char *data, size_t length, FILE *report) {
+    objFile ref, opt;
+    int refStatus = refParseBuffer(data, length, &ref);
+    int optStatus = objParseBuffer(data, length, &opt);
+    const char *problem = NULL;
+
+    if (refStatus != optStatus) {
+        problem = refStatus == 0 ? "optimized parser rejects input the reference accepts"
+                                 : "optimized parser accepts input the reference rejects";
+    }
+    else if (refStatus == 0) {
+        if (strcmp(ref.header.progName, opt.header.progName) != 0 ||
+            ref.header.startAddress != opt.header.startAddress ||
+            ref.header.programLength != opt.header.programLength) {
+            problem = "H record differs";
+        }
+        else if (ref.endRecord.firstExecAddress != opt.endRecord.firstExecAddress) {
+            problem = "E record differs";
+        }
+        else if (ref.textCount != opt.textCount || ref.modCount != opt.modCount) {
+            problem = "record counts differ";
+        }
+        for (size_t i = 0; !problem && i < ref.textCount; i++) {
+            textRecord *o = &opt.textRecords[i];
+            if (objDecodeText(o) != 0 || o->address != ref.textRecords[i].address ||
+                o->length != ref.textRecords[i].length ||
+                memcmp(o->bytes, ref.textRecords[i].bytes, o->length) != 0) {
+                problem = "T record differs";
+            }
+        }
+        for (size_t i = 0; !problem && i < ref.modCount; i++) {
+            const modRecord *o = &opt.modRecords[i];
+            if (o->address != ref.modRecords[i].address ||
+                o->lengthNibbles != ref.modRecords[i].lengthNibbles ||
+                o->sign != ref.modRecords[i].sign) {
+                problem = "M record differs";
+            }
+        }
+    }
+
+    if (refStatus == 0) {
+        objFree(&ref);
+    }
+    if (optStatus == 0) {
+        objFree(&opt);
+    }
+    if (problem && report) {
+        fprintf(report, "MISMATCH parse: %s\n", problem);
+    }
+    return problem ? 1 : 0;
+}
+
+int verifyBuffer(const char *data, size_t length, uint32_t reloc,
+                 machineType machine, FILE *report) {
+    runResult ref, opt;
+    int mismatch = 0;
+
+    runBoth(data, length, reloc, machine, 1, &ref);
+    runBoth(data, length, reloc, machine, 0, &opt);
+
+    if (ref.status != opt.status) {
+        mismatch = 1;
+    }
+    else if (ref.status == RUN_FAILED) {
+        mismatch = strcmp(ref.message, opt.message) != 0;
+    }
+    else if (ref.status == RUN_OK) {
+        mismatch = ref.length != opt.length || memcmp(ref.text, opt.text, ref.length) != 0;
+    }
+
+    if (mismatch && report) {
+        fprintf(report, "MISMATCH %s at %06X:\n", machine == MACHINE_SIC ? "SIC" : "SICXE",
+                (unsigned int)reloc);
+        if (ref.status != opt.status) {
+            fprintf(report, "  reference %s, optimized %s\n", statusName(ref.status),
+                    statusName(opt.status));
+        }
+        else if (ref.status == RUN_FAILED) {
+            fprintf(report, "  reference: %s\n  optimized: %s\n", ref.message, opt.message);
+        }
+        else {
+            reportFirstDifference(report, ref.text, ref.length, opt.text, opt.length);
+        }
+    }
+
+    free(ref.text);
+    free(opt.text);
+    return mismatch;
+}
+
+// Read the whole file at path into a malloc()ed buffer
+static char *readWholeFile(const char *path, size_t *length) {
+    FILE *fp = fopen(path, "rb");
+    char *buf = NULL;
+    size_t used = 0, capacity = 0;
+
+    if (!fp) {
+        return NULL;
+    }
+    for (;;) {
+        if (used == capacity) {
+            capacity = capacity ? capacity * 2 : 4096;
+            char *temp = (char *)realloc(buf, capacity);
+            if (!temp) {
+                free(buf);
+                fclose(fp);
+                return NULL;
+            }
+            buf = temp;
+        }
+        size_t got = fread(buf + used, 1, capacity - used, fp);
+        used += got;
+        if (got == 0) {
+            break;
+        }
+    }
+    fclose(fp);
+    *length = used;
+    return buf;
+}
+
+int runVerify(const char *const *paths, size_t count) {
+    static const uint32_t relocs[] = {0x000000, 0x000100, 0x001000, 0x004000,
+                                      0x007FFF, 0x100000, 0xFFFFFF};
+    size_t failed = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        size_t length = 0;
+        char *data = readWholeFile(paths[i], &length);
+        int bad = 0;
+
+        if (!data) {
+            printf("FAIL %s: could not read file\n", paths[i]);
+            failed++;
+            continue;
+        }
+
+        bad |= verifyParse(data, length, stdout);
+
+        // Also relocate to the program's own start and just below it
+        objFile ref;
+        uint32_t start = 0;
+        if (refParseBuffer(data, length, &ref) == 0) {
+            start = ref.header.startAddress;
+            objFree(&ref);
+        }
+
+        for (int machine = MACHINE_SIC; machine <= MACHINE_SICXE; machine++) {
+            for (size_t k = 0; k < sizeof(relocs) / sizeof(relocs[0]); k++) {
+                bad |= verifyBuffer(data, length, relocs[k], (machineType)machine, stdout);
+            }
+            bad |= verifyBuffer(data, length, start, (machineType)machine, stdout);
+            bad |= verifyBuffer(data, length, (start - 0x10U) & 0xFFFFFFU, (machineType)machine, stdout);
+        }
+
+        printf("%s %s\n", bad ? "FAIL" : "PASS", paths[i]);
+        failed += bad ? 1 : 0;
+        free(data);
+    }
+    printf("%zu files verified, %zu failed\n", count, failed);
+    return failed ? 1 : 0;
+}
+
+// Growable text buffer for generated programs
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+} fuzzText;
+
+static void fuzzReserve(fuzzText *t, size_t extra) {
+    if (t->length + extra + 1 <= t->capacity) {
+        return;
+    }
+    size_t capacity = t->capacity ? t->capacity : 1024;
+    while (capacity < t->length + extra + 1) {
+        capacity *= 2;
+    }
+    char *temp = (char *)realloc(t->data, capacity);
+    if (!temp) {
+        fatal("Out of memory.");
+    }
+    t->data = temp;
+    t->capacity = capacity;
+}
+
+static void fuzzAppend(fuzzText *t, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(NULL, 0, fmt, args);
+    va_end(args);
+
+    fuzzReserve(t, (size_t)n);
+    va_start(args, fmt);
+    vsnprintf(t->data + t->length, (size_t)n + 1, fmt, args);
+    va_end(args);
+    t->length += (size_t)n;
+}
+
+static uint64_t fuzzNext(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+// Random number in [0, n)
+static uint32_t fuzzBelow(uint64_t *state, uint32_t n) {
+    return n ? (uint32_t)(fuzzNext(state) % n) : 0;
+}
+
+// Generate one H..E program into t and pick a relocation address for it
+static void fuzzProgram(uint64_t *rng, fuzzText *t, uint32_t *reloc) {
+    uint32_t start, addr, textCount, modCount;
+    uint32_t textAddr[VERIFY_FUZZ_MAX_TEXT], textLen[VERIFY_FUZZ_MAX_TEXT];
+    int lower = fuzzBelow(rng, 8) == 0;
+    int spaced = fuzzBelow(rng, 8) == 0;
+    const char *eol = fuzzBelow(rng, 8) == 0 ? "\r\n" : "\n";
+
+    switch (fuzzBelow(rng, 4)) {
+    case 0:
+        start = 0;
+        break;
+    case 1:
+        start = fuzzBelow(rng, 0x8000);
+        break;
+    case 2:
+        start = fuzzBelow(rng, 0x1000);
+        break;
+    default:
+        start = fuzzBelow(rng, 0x1000000);
+        break;
+    }
+
+    // T records in address order with small gaps, so M fields can straddle them
+    textCount = fuzzBelow(rng, VERIFY_FUZZ_MAX_TEXT + 1);
+    addr = start;
+    for (uint32_t i = 0; i < textCount; i++) {
+        addr += fuzzBelow(rng, 3) == 0 ? fuzzBelow(rng, 6) : 0;
+        textAddr[i] = addr;
+        textLen[i] = fuzzBelow(rng, 8) == 0 ? 0 : 1 + fuzzBelow(rng, MAX_T_BYTES);
+        addr += textLen[i];
+    }
+    uint32_t programLength = (addr - start) + fuzzBelow(rng, 4);
+    if (fuzzBelow(rng, 16) == 0) {
+        programLength = 0; // disables the parser's range checks
+    }
+
+    // H record: 1 to 6 character name, sometimes padded
+    char name[7];
+    uint32_t nameLen = 1 + fuzzBelow(rng, 6);
+    for (uint32_t i = 0; i < nameLen; i++) {
+        name[i] = (char)('A' + fuzzBelow(rng, 26));
+    }
+    name[nameLen] = '\0';
+    fuzzAppend(t, "H%s%-*s%06X%06X%s", spaced ? " " : "", fuzzBelow(rng, 2) ? 6 : (int)nameLen + 1,
+               name, start & 0xFFFFFFU, programLength & 0xFFFFFFU, eol);
+
+    // M records land inside (or across the end of) a random T record
+    modCount = textCount ? fuzzBelow(rng, VERIFY_FUZZ_MAX_MODS + 1) : 0;
+    uint32_t nextMod = 0;
+    for (uint32_t i = 0; i < textCount; i++) {
+        fuzzAppend(t, "T%s%06X%02X", spaced ? " " : "", textAddr[i] & 0xFFFFFFU, textLen[i]);
+        for (uint32_t j = 0; j < textLen[i]; j++) {
+            fuzzAppend(t, lower ? "%02x" : "%02X", fuzzBelow(rng, 256));
+        }
+        fuzzAppend(t, "%s", eol);
+
+        if (fuzzBelow(rng, 16) == 0) {
+            fuzzAppend(t, "%s", eol); // blank line
+        }
+
+        // Emit some of the M records between the T records
+        while (nextMod < modCount && fuzzBelow(rng, 3) == 0) {
+            nextMod++;
+            uint32_t k = fuzzBelow(rng, textCount);
+            uint32_t offset = textLen[k] ? fuzzBelow(rng, textLen[k]) : 0;
+            // Mostly the widths real code uses, but any two-digit width (0, or
+            // wider than a 32-bit field) is drawn too
+            uint32_t nibbles = fuzzBelow(rng, 2) ? (fuzzBelow(rng, 2) ? 5 : 6)
+                             : (fuzzBelow(rng, 4) ? 1 + fuzzBelow(rng, 10) : fuzzBelow(rng, 256));
+            char sign = fuzzBelow(rng, 32) == 0 ? '*' : (fuzzBelow(rng, 4) == 0 ? '-' : '+');
+            fuzzAppend(t, "M%s%06X%02X%c%s", spaced ? " " : "", (textAddr[k] + offset) & 0xFFFFFFU,
+                       nibbles, sign, eol);
+        }
+    }
+
+    uint32_t entry = start + (programLength ? fuzzBelow(rng, programLength) : 0);
+    fuzzAppend(t, "E%s%06X", spaced ? " " : "", entry & 0xFFFFFFU);
+    if (fuzzBelow(rng, 8) != 0) {
+        fuzzAppend(t, "%s", eol);
+    }
+
+    // Relocation address: same start, a negative factor, or anywhere
+    switch (fuzzBelow(rng, 5)) {
+    case 0:
+        *reloc = start;
+        break;
+    case 1:
+        *reloc = start - fuzzBelow(rng, 0x100);
+        break;
+    case 2:
+        *reloc = 0x8000 - fuzzBelow(rng, 0x200);
+        break;
+    case 3:
+        *reloc = fuzzBelow(rng, 0x8000);
+        break;
+    default:
+        *reloc = (uint32_t)fuzzNext(rng);
+        break;
+    }
+    *reloc &= 0xFFFFFFU;
+}
+
+// Turn t into near-valid input with a few random edits
+static void fuzzMutate(uint64_t *rng, fuzzText *t) {
+    static const char alphabet[] = "0123456789ABCDEFabcdefHTMEG+- \t\r\n";
+    uint32_t edits = 1 + fuzzBelow(rng, 3);
+
+    for (uint32_t e = 0; e < edits && t->length > 0; e++) {
+        size_t pos = fuzzBelow(rng, (uint32_t)t->length);
+
+        switch (fuzzBelow(rng, 4)) {
+        case 0: // replace a character
+            t->data[pos] = alphabet[fuzzBelow(rng, sizeof(alphabet) - 1)];
+            break;
+        case 1: // delete a character
+            memmove(t->data + pos, t->data + pos + 1, t->length - pos - 1);
+            t->length--;
+            break;
+        case 2: // insert a character
+            fuzzReserve(t, 1);
+            memmove(t->data + pos + 1, t->data + pos, t->length - pos);
+            t->data[pos] = alphabet[fuzzBelow(rng, sizeof(alphabet) - 1)];
+            t->length++;
+            break;
+        default: { // duplicate the line holding pos
+            size_t lineStart = pos, lineEnd = pos;
+            while (lineStart > 0 && t->data[lineStart - 1] != '\n') {
+                lineStart--;
+            }
+            while (lineEnd < t->length && t->data[lineEnd++] != '\n') {
+            }
+            size_t n = lineEnd - lineStart;
+            fuzzReserve(t, n);
+            memmove(t->data + lineEnd + n, t->data + lineEnd, t->length - lineEnd);
+            memcpy(t->data + lineEnd, t->data + lineStart, n);
+            t->length += n;
+            break;
+        }
+        }
+    }
+}
+
+int runFuzz(unsigned long count, unsigned long seed) {
+    uint64_t rng = ((uint64_t)seed << 1) ^ 0x9E3779B97F4A7C15ULL;
+    fuzzText t = {0};
+    unsigned long mismatches = 0, accepted = 0;
+
+    for (unsigned long i = 0; i < count; i++) {
+        uint32_t reloc;
+
+        t.length = 0;
+        fuzzProgram(&rng, &t, &reloc);
+        if (fuzzBelow(&rng, 2) == 0) {
+            fuzzMutate(&rng, &t);
+        }
+        machineType machine = fuzzBelow(&rng, 2) ? MACHINE_SICXE : MACHINE_SIC;
+
+        objFile probe;
+        if (refParseBuffer(t.data, t.length, &probe) == 0) {
+            accepted++;
+            objFree(&probe);
+        }
+
+        int bad = verifyParse(t.data, t.length, stdout);
+        bad |= verifyBuffer(t.data, t.length, reloc, machine, stdout);
+        if (bad) {
+            mismatches++;
+            printf("  case %lu (seed %lu) input:\n%.*s\n", i, seed, (int)t.length, t.data);
+        }
+    }
+
+    printf("%lu cases generated (%lu parse), %lu mismatches\n", count, accepted, mismatches);
+    free(t.data);
+    return mismatches ? 1 : 0;
+}
@@ -0,0 +1,430 @@
+#include "watch.h"
+#include "loader.h"
+#include "memory.h"
+#include "objFile.h"
+#include "trace.h"
+#include "util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+/**
+ * Implementation of the incremental watch mode.
+ *
+ * This file implements:
+ *   - Reading the relocation config into a table of watchRule entries
+ *   - A cache with one watchEntry per object file: the stat() signature of
+ *     the file it was loaded from and the text printRelocatedRecords()
+ *     produced for it
+ *   - reloadEntry(), which skips a file whose signature is unchanged,
+ *     otherwise parses and relocates it into fresh structures (fatal() is
+ *     trapped, so a bad file is reported and the previous output stays in
+ *     place) and rewrites the output file only when its content changed
+ *   - runWatch(): initial scan of the directory, then an inotify loop on
+ *     IN_CLOSE_WRITE / IN_MOVED_TO (reload) and IN_DELETE / IN_MOVED_FROM
+ *     (drop the cache entry and its output)
+ *
+ * Output files (*.reloc) and their temp files are never treated as input,
+ * so the output directory may be the watched directory itself.
+ */
+
+#ifdef __linux__
+
+#define WATCH_OUTPUT_SUFFIX ".reloc"
+#define WATCH_TEMP_SUFFIX ".tmp"
+
+// One line of the relocation config
+typedef struct {
+    char *name; // File name, or "*" for the default
+    uint32_t relocationAddress;
+    machineType machineType;
+} watchRule;
+
+// What stat() says about a file: a rewrite changes at least one field
+typedef struct {
+    dev_t device;
+    ino_t inode;
+    off_t size;
+    struct timespec modified;
+    struct timespec changed;
+} fileSignature;
+
+// Cached state of one object file
+typedef struct {
+    char *name; // File name inside the watched directory
+    fileSignature signature; // File the output was made from
+    int trusted; // signature is old enough to tell rewrites apart
+    char *output; // Relocated T/E records as written to the output file
+    size_t outputLength;
+} watchEntry;
+
+typedef struct {
+    const char *dirPath;
+    const char *outDir;
+    watchRule *rules;
+    size_t ruleCount;
+    watchEntry *entries;
+    size_t entryCount;
+    size_t entryCapacity;
+} watchState;
+
+static char *copyString(const char *s) {
+    char *copy = (char *)malloc(strlen(s) + 1);
+    if (!copy) {
+        fatal("Out of memory.");
+    }
+    strcpy(copy, s);
+    return copy;
+}
+
+static int hasSuffix(const char *s, const char *suffix) {
+    size_t n = strlen(s), m = strlen(suffix);
+    return n >= m && strcmp(s + n - m, suffix) == 0;
+}
+
+static void readConfig(watchState *w, const char *configPath) {
+    FILE *fp = fopen(configPath, "r");
+    char line[512];
+    size_t capacity = 0;
+
+    if (!fp) {
+        fatal("Could not open relocation config.");
+    }
+
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        char name[256], addr[64], machine[16];
+        if (line[0] == '#' || sscanf(line, "%255s %63s %15s", name, addr, machine) != 3) {
+            if (line[0] != '#' && strspn(line, " \t\r\n") != strlen(line)) {
+                fatal("Invalid line in relocation config.");
+            }
+            continue;
+        }
+
+        if (w->ruleCount == capacity) {
+            capacity = capacity ? capacity * 2 : 8;
+            watchRule *temp = (watchRule *)realloc(w->rules, capacity * sizeof(*temp));
+            if (!temp) {
+                fatal("Out of memory.");
+            }
+            w->rules = temp;
+        }
+
+        watchRule *r = &w->rules[w->ruleCount++];
+        r->name = copyString(name);
+        if (!parseHex(addr, &r->relocationAddress)) {
+            fatal("Invalid hex relocation address in relocation config.");
+        }
+        if (strcmp(machine, "SIC") == 0) {
+            r->machineType = MACHINE_SIC;
+        }
+        else if (strcmp(machine, "SICXE") == 0) {
+            r->machineType = MACHINE_SICXE;
+        }
+        else {
+            fatal("Invalid machine type in relocation config. Use SIC or SICXE.");
+        }
+    }
+    fclose(fp);
+}
+
+// Rule for a file name: its own entry, else '*', else NULL (not watched)
+static const watchRule *findRule(const watchState *w, const char *name) {
+    const watchRule *fallback = NULL;
+
+    if (name[0] == '.' || hasSuffix(name, WATCH_OUTPUT_SUFFIX) || hasSuffix(name, WATCH_TEMP_SUFFIX)) {
+        return NULL;
+    }
+    for (size_t i = 0; i < w->ruleCount; i++) {
+        if (strcmp(w->rules[i].name, name) == 0) {
+            return &w->rules[i];
+        }
+        if (strcmp(w->rules[i].name, "*") == 0) {
+            fallback = &w->rules[i];
+        }
+    }
+    return fallback;
+}
+
+static watchEntry *findEntry(watchState *w, const char *name, int create) {
+    for (size_t i = 0; i < w->entryCount; i++) {
+        if (strcmp(w->entries[i].name, name) == 0) {
+            return &w->entries[i];
+        }
+    }
+    if (!create) {
+        return NULL;
+    }
+
+    if (w->entryCount == w->entryCapacity) {
+        size_t capacity = w->entryCapacity ? w->entryCapacity * 2 : 64;
+        watchEntry *temp = (watchEntry *)realloc(w->entries, capacity * sizeof(*temp));
+        if (!temp) {
+            fatal("Out of memory.");
+        }
+        w->entries = temp;
+        w->entryCapacity = capacity;
+    }
+    watchEntry *e = &w->entries[w->entryCount++];
+    memset(e, 0, sizeof(*e));
+    e->name = copyString(name);
+    return e;
+}
+
+static char *joinPath(const char *dir, const char *name, const char *suffix) {
+    size_t n = strlen(dir) + strlen(name) + strlen(suffix) + 2;
+    char *path = (char *)malloc(n);
+    if (!path) {
+        fatal("Out of memory.");
+    }
+    snprintf(path, n, "%s/%s%s", dir, name, suffix);
+    return path;
+}
+
+static uint64_t elapsedUs(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)(now.tv_sec - start->tv_sec) * 1000000ULL +
+           (uint64_t)((now.tv_nsec - start->tv_nsec) / 1000);
+}
+
+static void readSignature(const struct stat *st, fileSignature *sig) {
+    memset(sig, 0, sizeof(*sig));
+    sig->device = st->st_dev;
+    sig->inode = st->st_ino;
+    sig->size = st->st_size;
+    sig->modified = st->st_mtim;
+    sig->changed = st->st_ctim;
+}
+
+static int sameSignature(const fileSignature *a, const fileSignature *b) {
+    return a->device == b->device && a->inode == b->inode && a->size == b->size &&
+           a->modified.tv_sec == b->modified.tv_sec && a->modified.tv_nsec == b->modified.tv_nsec &&
+           a->changed.tv_sec == b->changed.tv_sec && a->changed.tv_nsec == b->changed.tv_nsec;
+}
+
+// Write data to path atomically: temp file first, then rename over path
+static int writeAtomically(const char *path, const char *data, size_t length) {
+    size_t n = strlen(path) + sizeof(WATCH_TEMP_SUFFIX);
+    char *temp = (char *)malloc(n);
+    if (!temp) {
+        return -1;
+    }
+    snprintf(temp, n, "%s%s", path, WATCH_TEMP_SUFFIX);
+
+    FILE *fp = fopen(temp, "wb");
+    int result = -1;
+    if (fp) {
+        int ok = fwrite(data, 1, length, fp) == length;
+        if (fclose(fp) == 0 && ok && rename(temp, path) == 0) {
+            result = 0;
+        }
+    }
+    if (result != 0) {
+        remove(temp);
+    }
+    free(temp);
+    return result;
+}
+
+// Parse, relocate and emit one object; the cache changes only on success
+static void reloadEntry(watchState *w, const char *name, const watchRule *rule) {
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    char *inPath = joinPath(w->dirPath, name, "");
+    struct stat st;
+    fileSignature signature;
+    int haveSignature = stat(inPath, &st) == 0;
+    if (haveSignature) {
+        readSignature(&st, &signature);
+    }
+
+    // Same file as last time: nothing to parse. A signature taken in the
+    // same second as the file was written is not trusted, since a second
+    // write within the timestamp granularity could leave it unchanged.
+    watchEntry *cached = findEntry(w, name, 0);
+    if (cached && cached->trusted && haveSignature &&
+        sameSignature(&cached->signature, &signature)) {
+        printf("unchanged %s (%llu us)\n", name, (unsigned long long)elapsedUs(&start));
+        fflush(stdout);
+        free(inPath);
+        return;
+    }
+
+    objFile fresh;
+    char *output = NULL;
+    size_t outputLength = 0;
+    volatile int relocated = 0;
+
+    if (objParseFile(inPath, &fresh) != 0) {
+        if (objParseMessage()) {
+            printf("Error: %s: %s\n", name, objParseMessage());
+        }
+        printf("Error: %s: Failed to parse SCOFF file.\n", name);
+        free(inPath);
+        return;
+    }
+
+    // The stream is opened before setjmp(), so output and outputLength are
+    // only written through it and are read back after fclose()
+    FILE *mem = open_memstream(&output, &outputLength);
+    if (!mem) {
+        printf("Error: %s: out of memory; keeping the previous output.\n", name);
+        objFree(&fresh);
+        free(inPath);
+        return;
+    }
+
+    jmp_buf trap;
+    jmp_buf *previous = fatalSetTrap(&trap);
+    if (setjmp(trap) == 0) {
+        memInit();
+        relocateObject(&fresh, rule->relocationAddress, rule->machineType);
+        printRelocatedRecords(&fresh, mem);
+        relocated = 1;
+    }
+    fatalSetTrap(previous);
+    int written = fclose(mem) == 0;
+    objFree(&fresh);
+
+    if (!relocated || !written) {
+        printf("Error: %s: %s; keeping the previous output.\n", name,
+               !relocated && fatalMessage() ? fatalMessage() : "out of memory");
+        free(output);
+        free(inPath);
+        return;
+    }
+
+    watchEntry *e = findEntry(w, name, 1);
+    int changed = !e->output || e->outputLength != outputLength ||
+                  memcmp(e->output, output, outputLength) != 0;
+
+    if (changed) {
+        char *outPath = joinPath(w->outDir, name, WATCH_OUTPUT_SUFFIX);
+        if (writeAtomically(outPath, output, outputLength) != 0) {
+            printf("Error: %s: could not write %s.\n", name, outPath);
+            free(outPath);
+            free(output);
+            free(inPath);
+            return;
+        }
+        free(outPath);
+    }
+
+    free(e->output);
+    e->output = output;
+    e->outputLength = outputLength;
+    e->trusted = 0;
+    if (haveSignature) {
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        e->signature = signature;
+        e->trusted = signature.modified.tv_sec < now.tv_sec &&
+                     signature.changed.tv_sec < now.tv_sec;
+    }
+
+    printf("%s %s (%llu us)\n", changed ? "updated" : "unchanged", name,
+           (unsigned long long)elapsedUs(&start));
+    fflush(stdout);
+    free(inPath);
+}
+
+static void dropEntry(watchState *w, const char *name) {
+    watchEntry *e = findEntry(w, name, 0);
+    if (!e) {
+        return;
+    }
+
+    char *outPath = joinPath(w->outDir, name, WATCH_OUTPUT_SUFFIX);
+    remove(outPath);
+    free(outPath);
+
+    free(e->output);
+    free(e->name);
+    *e = w->entries[--w->entryCount];
+
+    printf("removed %s\n", name);
+    fflush(stdout);
+}
+
+int runWatch(const char *dirPath, const char *configPath, const char *outDir) {
+    watchState w;
+    memset(&w, 0, sizeof(w));
+    w.dirPath = dirPath;
+    w.outDir = outDir ? outDir : dirPath;
+
+    readConfig(&w, configPath);
+
+    int fd = inotify_init1(IN_CLOEXEC);
+    if (fd < 0 || inotify_add_watch(fd, dirPath, IN_CLOSE_WRITE | IN_MOVED_TO |
+                                    IN_DELETE | IN_MOVED_FROM) < 0) {
+        fatal("Could not watch the object directory.");
+    }
+
+    // Initial load of everything already in the directory
+    DIR *dir = opendir(dirPath);
+    if (!dir) {
+        fatal("Could not open the object directory.");
+    }
+    struct dirent *de;
+    while ((de = readdir(dir)) != NULL) {
+        const watchRule *rule = findRule(&w, de->d_name);
+        char *path = joinPath(dirPath, de->d_name, "");
+        struct stat st;
+        if (rule && stat(path, &st) == 0 && S_ISREG(st.st_mode)) {
+            reloadEntry(&w, de->d_name, rule);
+        }
+        free(path);
+    }
+    closedir(dir);
+
+    // Incremental updates
+    char events[64 * 1024] __attribute__((aligned(__alignof__(struct inotify_event))));
+    for (;;) {
+        ssize_t n = read(fd, events, sizeof(events));
+        if (n <= 0) {
+            fatal("Lost the inotify watch.");
+        }
+
+        for (char *p = events; p < events + n; ) {
+            const struct inotify_event *ev = (const struct inotify_event *)p;
+            p += sizeof(*ev) + ev->len;
+
+            if (ev->len == 0) {
+                continue;
+            }
+            const watchRule *rule = findRule(&w, ev->name);
+            if (!rule) {
+                continue;
+            }
+            if (ev->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+                reloadEntry(&w, ev->name, rule);
+            }
+            else if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                dropEntry(&w, ev->name);
+            }
+        }
+    }
+    return 0;
+}
+
+#else
+
+int runWatch(const char *dirPath, const char *configPath, const char *outDir) {
+    (void)dirPath;
+    (void)configPath;
+    (void)outDir;
+    fatal("Watch mode needs inotify and is only available on Linux.");
+    return 1;
+}
+
+#endif